@@ -17,25 +17,66 @@
 #error TIMER_FREQ <= 1000 recommended
 #endif
 
+/* 8254 input frequency divided by TIMER_FREQ, rounded to
+   nearest: the number of PIT counts in one timer tick. */
+#define PIT_COUNT ((1193180 + TIMER_FREQ / 2) / TIMER_FREQ)
+
 /* Number of timer ticks since OS booted. */
 static int64_t ticks;
 
-/*List for thread in sleeping
-  added for timer_sleep */
-static struct list sleep_list;
+/* -tickless: Stop the periodic tick while the CPU is idle? */
+bool timer_tickless;
+
+/* Tickless idle state.  While idle, the PIT may be switched from
+   periodic mode to a one-shot countdown that ends exactly on the
+   tick boundary of the next timer event.  Whichever interrupt
+   ends the idle period, timer_resume() runs first, returns the
+   PIT to periodic mode and replays the ticks that have passed. */
+static bool oneshot_armed;      /* PIT is counting down a one-shot? */
+static unsigned oneshot_counts; /* PIT counts programmed for it. */
+static uint16_t oneshot_phase;  /* Counts left in the tick it was armed in. */
+static int64_t oneshot_ticks;   /* Ticks that pass before it fires. */
+
+/* Sleeping threads, in a hierarchical timing wheel.
+
+   Level 0 has one slot for each of the next WHEEL_SLOTS ticks.
+   Each slot of level N covers WHEEL_SLOTS**N ticks, so a sleeper
+   is filed in the lowest level whose span reaches its wake-up
+   time.  When level 0 wraps around, the level 1 slot for the
+   next WHEEL_SLOTS ticks is "cascaded": its threads are filed
+   again, this time in level 0, and likewise for higher levels.
+   Arming a sleep and expiring a slot therefore take constant
+   time per thread, and each tick only touches the current slot.
+
+   Sleeps longer than the whole wheel are parked in the farthest
+   slot of the top level and refiled when it cascades.  All of
+   this is protected by disabling interrupts. */
+#define WHEEL_BITS 6                            /* Log2 of slots per level. */
+#define WHEEL_SLOTS (1 << WHEEL_BITS)           /* Slots per level. */
+#define WHEEL_MASK (WHEEL_SLOTS - 1)
+#define WHEEL_LEVELS 4                          /* Number of levels. */
+static struct list wheel[WHEEL_LEVELS][WHEEL_SLOTS];
+
+/* Next tick whose level 0 slot has not yet been expired. */
+static int64_t wheel_base;
 
 /* Number of loops per timer tick.
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
 
 static intr_handler_func timer_interrupt;
+static intr_entry_func timer_resume;
 static bool too_many_loops (unsigned loops);
 static void busy_wait (int64_t loops);
 static void real_time_sleep (int64_t num, int32_t denom);
 
-static bool wake_ticks_compare(const struct list_elem *a, 
-                                const struct list_elem *b,
-                                void *aux UNUSED);
+static void pit_set_periodic (void);
+static void pit_set_oneshot (unsigned counts);
+static uint16_t pit_read_counter (void);
+static bool pit_output_high (void);
+static int64_t wheel_quiet_ticks (int64_t max);
+static void wheel_insert (struct thread *);
+static void wheel_cascade (int level);
 void timer_wakeup(void);
 
 /* Sets up the 8254 Programmable Interval Timer (PIT) to
@@ -44,17 +85,18 @@ void timer_wakeup(void);
 void
 timer_init (void) 
 {
-  /* 8254 input frequency divided by TIMER_FREQ, rounded to
-     nearest. */
-  uint16_t count = (1193180 + TIMER_FREQ / 2) / TIMER_FREQ;
+  int level, slot;
 
-  outb (0x43, 0x34);    /* CW: counter 0, LSB then MSB, mode 2, binary. */
-  outb (0x40, count & 0xff);
-  outb (0x40, count >> 8);
+  pit_set_periodic ();
 
   intr_register_ext (0x20, timer_interrupt, "8254 Timer");
+  if (timer_tickless)
+    intr_register_entry (timer_resume);
 
-  list_init (&sleep_list);
+  for (level = 0; level < WHEEL_LEVELS; level++)
+    for (slot = 0; slot < WHEEL_SLOTS; slot++)
+      list_init (&wheel[level][slot]);
+  wheel_base = ticks + 1;
 }
 
 /* Calibrates loops_per_tick, used to implement brief delays. */
@@ -112,12 +154,15 @@ timer_sleep (int64_t ticks)
 
   ASSERT (!intr_context());
 
+  if (ticks <= 0)
+    return;
+
   old_level = intr_disable();
 
   int64_t start = timer_ticks ();
 
   curr->wake_ticks = start + ticks;
-  list_insert_ordered(&sleep_list, &curr->elem, wake_ticks_compare, NULL);
+  wheel_insert (curr);
   thread_block();
 
   /*
@@ -156,16 +201,140 @@ timer_print_stats (void)
   printf ("Timer: %"PRId64" ticks\n", timer_ticks ());
 }
 
+/* Idles the CPU until the next interrupt.  Called by the idle
+   thread with interrupts off; returns with interrupts on.
+
+   In tickless mode, if no timer event is due at the next tick,
+   the PIT is put in one-shot mode to skip the quiet ticks.  The
+   16-bit counter limits one such sleep to 65535 PIT counts,
+   about 55 ms. */
+void
+timer_idle (void)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (timer_tickless)
+    {
+      uint16_t phase = pit_read_counter ();
+      int64_t quiet = wheel_quiet_ticks ((0xffff - phase) / PIT_COUNT);
+
+      if (quiet > 0)
+        {
+          oneshot_armed = true;
+          oneshot_phase = phase;
+          oneshot_counts = phase + quiet * PIT_COUNT;
+          oneshot_ticks = quiet + 1;
+          pit_set_oneshot (oneshot_counts);
+        }
+    }
+
+  /* Re-enable interrupts and wait for the next one.
+     The `sti' instruction disables interrupts until the
+     completion of the next instruction, so these two
+     instructions are executed atomically.  This atomicity is
+     important; otherwise, an interrupt could be handled
+     between re-enabling interrupts and waiting for the next
+     one to occur, wasting as much as one clock tick worth of
+     time.
+     See [IA32-v2a] "HLT", [IA32-v2b] "STI", and [IA32-v3a]
+     7.11.1 "HLT Instruction". */
+  asm volatile ("sti; hlt" : : : "memory");
+}
+
+/* Ends a tickless idle period, if one is in progress.  Runs at
+   the start of every external interrupt, before its handler, so
+   that the handler and any thread it wakes see an up-to-date
+   `ticks' and timing wheel, and so that the PIT is back in
+   periodic mode before anything else can run.
+
+   If the one-shot has expired, its interrupt is either the one
+   being handled or pending, and timer_interrupt() accounts for
+   the last tick it covers, so only the ticks before that one
+   are replayed here.  Otherwise, the tick boundaries that the
+   counter has passed are replayed.  The counter is read before
+   the output is checked, so that an expired counter, which has
+   wrapped around, is never used; a one-shot that expires after
+   the check leaves its interrupt pending to count the tick it
+   ends. */
+static void
+timer_resume (void)
+{
+  unsigned elapsed;
+  int64_t n;
+
+  if (!oneshot_armed)
+    return;
+
+  elapsed = oneshot_counts - pit_read_counter ();
+  if (pit_output_high ())
+    n = oneshot_ticks - 1;
+  else if (elapsed >= oneshot_phase)
+    n = 1 + (elapsed - oneshot_phase) / PIT_COUNT;
+  else
+    n = 0;
+  oneshot_armed = false;
+  pit_set_periodic ();
+
+  while (n-- > 0)
+    {
+      ticks++;
+      thread_tick ();
+      timer_wakeup ();
+    }
+}
+
 /* Timer interrupt handler. */
 static void
 timer_interrupt (struct intr_frame *args UNUSED)
 {
   ticks++;
-  
   thread_tick ();
   timer_wakeup();
 }
 
+/* Sets up the 8254 Programmable Interval Timer (PIT) to
+   interrupt TIMER_FREQ times per second. */
+static void
+pit_set_periodic (void)
+{
+  outb (0x43, 0x34);    /* CW: counter 0, LSB then MSB, mode 2, binary. */
+  outb (0x40, PIT_COUNT & 0xff);
+  outb (0x40, PIT_COUNT >> 8);
+}
+
+/* Sets up the PIT to interrupt once, COUNTS PIT counts from
+   now. */
+static void
+pit_set_oneshot (unsigned counts)
+{
+  ASSERT (counts > 0 && counts <= 0xffff);
+
+  outb (0x43, 0x30);    /* CW: counter 0, LSB then MSB, mode 0, binary. */
+  outb (0x40, counts & 0xff);
+  outb (0x40, counts >> 8);
+}
+
+/* Returns the current value of PIT counter 0. */
+static uint16_t
+pit_read_counter (void)
+{
+  uint8_t lo, hi;
+
+  outb (0x43, 0x00);    /* CW: counter 0, latch count. */
+  lo = inb (0x40);
+  hi = inb (0x40);
+  return lo | (hi << 8);
+}
+
+/* Returns true if PIT counter 0's output is high, which in
+   one-shot mode means that the countdown has finished. */
+static bool
+pit_output_high (void)
+{
+  outb (0x43, 0xe2);    /* Read-back: counter 0, latch status only. */
+  return (inb (0x40) & 0x80) != 0;
+}
+
 /* Returns true if LOOPS iterations waits for more than one timer
    tick, otherwise false. */
 static bool
@@ -229,39 +398,90 @@ real_time_sleep (int64_t num, int32_t denom)
     }
 }
 
-static bool
-wake_ticks_compare(const struct list_elem *a, const struct list_elem *b,
-                    void *aux UNUSED)
+/* Files sleeping thread T in the timing wheel slot that will be
+   reached at or shortly before T's wake_ticks, relative to
+   wheel_base.  T must wake no earlier than wheel_base. */
+static void
+wheel_insert (struct thread *t)
 {
-  struct thread *thread_a = list_entry(a, struct thread, elem);
-  struct thread *thread_b = list_entry(b, struct thread, elem);
-  int64_t a_wake_ticks = thread_a -> wake_ticks;
-  int64_t b_wake_ticks = thread_b -> wake_ticks;
+  int64_t delta = t->wake_ticks - wheel_base;
+  int64_t when = t->wake_ticks;
+  int level;
 
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (delta >= 0);
+
+  for (level = 0; level < WHEEL_LEVELS - 1; level++)
+    if (delta < (int64_t) 1 << (WHEEL_BITS * (level + 1)))
+      break;
 
-  if(a_wake_ticks < b_wake_ticks) return true;
-  else return false;
+  /* Too far in the future even for the top level: park it in
+     the top level's last slot to be refiled later. */
+  if (delta >= (int64_t) 1 << (WHEEL_BITS * WHEEL_LEVELS))
+    when = wheel_base + ((int64_t) 1 << (WHEEL_BITS * WHEEL_LEVELS)) - 1;
 
-  //return (a_wake_ticks < b_wake_ticks ? true : false);
+  list_push_back (&wheel[level][(when >> (WHEEL_BITS * level)) & WHEEL_MASK],
+                  &t->elem);
 }
 
+/* Returns the number of ticks, starting at wheel_base and up to
+   MAX, that can pass without any thread waking up.  Ticks at
+   which a level cascades are never counted as quiet, because a
+   cascade may bring down a thread that wakes on that tick. */
+static int64_t
+wheel_quiet_ticks (int64_t max)
+{
+  int64_t quiet;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (quiet = 0; quiet < max; quiet++)
+    {
+      int64_t t = wheel_base + quiet;
+      if ((t & WHEEL_MASK) == 0 || !list_empty (&wheel[0][t & WHEEL_MASK]))
+        break;
+    }
+  return quiet;
+}
+
+/* Refiles every thread in the current slot of wheel level LEVEL
+   into lower levels. */
+static void
+wheel_cascade (int level)
+{
+  struct list *slot;
+
+  slot = &wheel[level][(wheel_base >> (WHEEL_BITS * level)) & WHEEL_MASK];
+  while (!list_empty (slot))
+    wheel_insert (list_entry (list_pop_front (slot), struct thread, elem));
+}
+
+/* Wakes up the threads whose sleep ends at the current tick.
+   Called once per tick from the timer interrupt. */
 void
 timer_wakeup(void)
 {
-  struct thread *t;
-  int64_t wake_ticks;
+  struct list *slot;
+  int level;
 
-  while(!list_empty(&sleep_list)){
-    t = list_entry (list_front (&sleep_list), struct thread, elem);
-    wake_ticks = t -> wake_ticks;
+  ASSERT (wheel_base == ticks);
 
-    if(wake_ticks<=ticks){
-      list_pop_front(&sleep_list);
-      thread_unblock(t);
-    }
-    else{
-      break;
+  /* When a level wraps around, pull the next span of the level
+     above it down into the wheel. */
+  for (level = 1; level < WHEEL_LEVELS; level++)
+    {
+      if (((wheel_base >> (WHEEL_BITS * (level - 1))) & WHEEL_MASK) != 0)
+        break;
+      wheel_cascade (level);
     }
 
-  }
+  slot = &wheel[0][wheel_base & WHEEL_MASK];
+  while (!list_empty (slot))
+    {
+      struct thread *t = list_entry (list_pop_front (slot), struct thread, elem);
+      ASSERT (t->wake_ticks == wheel_base);
+      thread_trace (TRACE_WAKEUP, t, 0);
+      thread_unblock (t);
+    }
+  wheel_base++;
 }
\ No newline at end of file
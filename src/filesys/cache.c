@@ -0,0 +1,384 @@
+#include "filesys/cache.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/filesys.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/* Buffer cache.
+
+   Every sector that the file system reads or writes goes through
+   a cache of CACHE_SIZE sectors.  Writes are write-back: they
+   only mark the cached copy dirty, and the sector goes to disk
+   when its entry is evicted or when cache_flush() runs, which
+   filesys_done() does at shutdown.
+
+   Entries are replaced by the clock algorithm.  Each access sets
+   an entry's `accessed' bit; the clock hand sweeps the entries,
+   clearing set bits, and evicts the first entry it finds with
+   the bit clear that nobody is using.
+
+   Locking is in two levels.  cache_lock protects the mapping
+   from sectors to entries, the clock hand, and each entry's
+   `pin_cnt', `accessed', and `sector' members.  Each entry's own
+   lock protects its data and its `valid' and `dirty' bits, and
+   is held across the disk I/O that fills or writes back the
+   entry, so that I/O on one sector does not hold up hits on
+   others.  An entry with a nonzero `pin_cnt' is never evicted.
+   Only a thread that has pinned an entry takes its lock, so
+   cache_lock alone is enough to examine or take over an entry
+   that is not pinned.
+
+   A dirty victim is written back while it still maps its old
+   sector, so that a concurrent reader of that sector waits for
+   the write and finds the entry again rather than reading a
+   stale copy from disk.
+
+   cache_readahead() queues a sector to be read into the cache by
+   the "readahead" kernel thread, so that a sequential reader
+   finds the next sectors already cached when it gets to them.
+   Sectors brought in this way start with their `accessed' bit
+   clear, so that a prefetch that turns out to be useless is the
+   first thing to go. */
+
+/* Number of sectors in the cache. */
+#define CACHE_SIZE 64
+
+/* Maximum number of queued read-ahead requests.  Requests made
+   while the queue is full are dropped. */
+#define READAHEAD_QUEUE 64
+
+/* A cached sector. */
+struct cache_entry
+  {
+    disk_sector_t sector;       /* Sector held, if `in_use'. */
+    bool in_use;                /* Holds a sector? */
+    bool accessed;              /* Used since the clock hand passed? */
+    int pin_cnt;                /* Number of threads using the entry. */
+
+    struct lock lock;           /* Protects the members below. */
+    bool valid;                 /* Does `data' hold the sector's data? */
+    bool dirty;                 /* Does `data' need to be written back? */
+    uint8_t *data;              /* DISK_SECTOR_SIZE bytes of data. */
+  };
+
+static struct cache_entry cache[CACHE_SIZE];
+static struct lock cache_lock;
+static struct condition cache_unpinned; /* Signaled when `pin_cnt' drops. */
+static size_t clock_hand;
+
+/* Read-ahead queue. */
+static disk_sector_t readahead_queue[READAHEAD_QUEUE];
+static size_t readahead_head, readahead_tail; /* Pop at head, push at tail. */
+static struct lock readahead_lock;
+static struct condition readahead_wanted; /* Signaled when queue nonempty. */
+
+/* Statistics. */
+static long long hit_cnt, miss_cnt, write_back_cnt;
+static long long readahead_cnt, readahead_drop_cnt;
+
+static struct cache_entry *lookup (disk_sector_t);
+static struct cache_entry *cache_get (disk_sector_t, bool need_data);
+static void cache_put (struct cache_entry *, bool dirty);
+static void unpin (struct cache_entry *, bool accessed);
+static thread_func readahead_thread;
+
+/* Initializes the buffer cache. */
+void
+cache_init (void)
+{
+  uint8_t *data;
+  size_t i;
+
+  data = palloc_get_multiple (PAL_ASSERT,
+                              CACHE_SIZE * DISK_SECTOR_SIZE / PGSIZE);
+  lock_init_named (&cache_lock, "cache");
+  cond_init (&cache_unpinned);
+  for (i = 0; i < CACHE_SIZE; i++)
+    {
+      struct cache_entry *e = &cache[i];
+      e->in_use = false;
+      e->accessed = false;
+      e->pin_cnt = 0;
+      lock_init (&e->lock);
+      e->valid = false;
+      e->dirty = false;
+      e->data = data + i * DISK_SECTOR_SIZE;
+    }
+
+  lock_init (&readahead_lock);
+  cond_init (&readahead_wanted);
+  thread_create ("readahead", PRI_DEFAULT, readahead_thread, NULL);
+}
+
+/* Writes every dirty sector in the cache to disk. */
+void
+cache_flush (void)
+{
+  size_t i;
+
+  for (i = 0; i < CACHE_SIZE; i++)
+    {
+      struct cache_entry *e = &cache[i];
+
+      lock_acquire (&cache_lock);
+      if (!e->in_use || !e->dirty)
+        {
+          lock_release (&cache_lock);
+          continue;
+        }
+      e->pin_cnt++;
+      lock_release (&cache_lock);
+
+      lock_acquire (&e->lock);
+      if (e->dirty)
+        {
+          disk_write (filesys_disk, e->sector, e->data);
+          e->dirty = false;
+          write_back_cnt++;
+        }
+      lock_release (&e->lock);
+      unpin (e, false);
+    }
+}
+
+/* Prints buffer cache statistics. */
+void
+cache_print_stats (void)
+{
+  printf ("Cache: %lld hits, %lld misses, %lld write-backs, "
+          "%lld read-ahead, %lld read-ahead dropped\n",
+          hit_cnt, miss_cnt, write_back_cnt,
+          readahead_cnt, readahead_drop_cnt);
+}
+
+/* Asks for SECTOR to be read into the cache in the background,
+   if it is not there already.  Returns without waiting. */
+void
+cache_readahead (disk_sector_t sector)
+{
+  lock_acquire (&readahead_lock);
+  if (readahead_tail - readahead_head < READAHEAD_QUEUE)
+    {
+      readahead_queue[readahead_tail++ % READAHEAD_QUEUE] = sector;
+      cond_signal (&readahead_wanted, &readahead_lock);
+    }
+  else
+    readahead_drop_cnt++;
+  lock_release (&readahead_lock);
+}
+
+/* Reads sector SECTOR into BUFFER, which must have room for
+   DISK_SECTOR_SIZE bytes. */
+void
+cache_read (disk_sector_t sector, void *buffer)
+{
+  cache_read_at (sector, buffer, 0, DISK_SECTOR_SIZE);
+}
+
+/* Writes sector SECTOR from BUFFER, which must contain
+   DISK_SECTOR_SIZE bytes. */
+void
+cache_write (disk_sector_t sector, const void *buffer)
+{
+  cache_write_at (sector, buffer, 0, DISK_SECTOR_SIZE);
+}
+
+/* Reads SIZE bytes starting at byte offset OFS within sector
+   SECTOR into BUFFER. */
+void
+cache_read_at (disk_sector_t sector, void *buffer, size_t ofs, size_t size)
+{
+  struct cache_entry *e;
+
+  ASSERT (ofs <= DISK_SECTOR_SIZE);
+  ASSERT (size <= DISK_SECTOR_SIZE - ofs);
+
+  e = cache_get (sector, true);
+  memcpy (buffer, e->data + ofs, size);
+  cache_put (e, false);
+}
+
+/* Writes SIZE bytes from BUFFER into sector SECTOR, starting at
+   byte offset OFS within the sector.  The rest of the sector is
+   read from disk first if it is not already cached, unless the
+   write covers the whole sector. */
+void
+cache_write_at (disk_sector_t sector, const void *buffer,
+                size_t ofs, size_t size)
+{
+  struct cache_entry *e;
+
+  ASSERT (ofs <= DISK_SECTOR_SIZE);
+  ASSERT (size <= DISK_SECTOR_SIZE - ofs);
+
+  e = cache_get (sector, size < DISK_SECTOR_SIZE);
+  memcpy (e->data + ofs, buffer, size);
+  e->valid = true;
+  cache_put (e, true);
+}
+
+/* Returns the entry in the cache that holds SECTOR, or a null
+   pointer if there is none.  The caller must hold cache_lock. */
+static struct cache_entry *
+lookup (disk_sector_t sector)
+{
+  size_t i;
+
+  for (i = 0; i < CACHE_SIZE; i++)
+    if (cache[i].in_use && cache[i].sector == sector)
+      return &cache[i];
+  return NULL;
+}
+
+/* Advances the clock hand to an entry that can be evicted and
+   returns it, or returns a null pointer if every entry is
+   pinned.  The caller must hold cache_lock. */
+static struct cache_entry *
+choose_victim (void)
+{
+  size_t i;
+
+  /* Two sweeps are enough: the first clears every accessed bit
+     that could stop the second. */
+  for (i = 0; i < 2 * CACHE_SIZE; i++)
+    {
+      struct cache_entry *e = &cache[clock_hand];
+      clock_hand = (clock_hand + 1) % CACHE_SIZE;
+
+      if (!e->in_use)
+        return e;
+      else if (e->pin_cnt > 0)
+        continue;
+      else if (e->accessed)
+        e->accessed = false;
+      else
+        return e;
+    }
+  return NULL;
+}
+
+/* Returns the cache entry for SECTOR, pinned and with its lock
+   held, evicting another sector if necessary.  If NEED_DATA is
+   true, the entry's data is read from disk if it is not already
+   cached; otherwise, the caller must overwrite all of it and
+   then set `valid'. */
+static struct cache_entry *
+cache_get (disk_sector_t sector, bool need_data)
+{
+  struct cache_entry *e;
+
+  lock_acquire (&cache_lock);
+  for (;;)
+    {
+      e = lookup (sector);
+      if (e != NULL)
+        {
+          hit_cnt++;
+          break;
+        }
+
+      e = choose_victim ();
+      if (e == NULL)
+        cond_wait (&cache_unpinned, &cache_lock);
+      else if (e->in_use && e->dirty)
+        {
+          /* Write back the victim, then look again, since
+             anything may have happened without cache_lock. */
+          e->pin_cnt++;
+          lock_release (&cache_lock);
+
+          lock_acquire (&e->lock);
+          if (e->dirty)
+            {
+              disk_write (filesys_disk, e->sector, e->data);
+              e->dirty = false;
+              write_back_cnt++;
+            }
+          lock_release (&e->lock);
+
+          lock_acquire (&cache_lock);
+          if (--e->pin_cnt == 0)
+            cond_broadcast (&cache_unpinned, &cache_lock);
+        }
+      else
+        {
+          /* Take over the clean victim for SECTOR. */
+          miss_cnt++;
+          e->sector = sector;
+          e->in_use = true;
+          e->accessed = false;
+          e->valid = false;
+          break;
+        }
+    }
+  e->pin_cnt++;
+  lock_release (&cache_lock);
+
+  lock_acquire (&e->lock);
+  if (!e->valid && need_data)
+    {
+      disk_read (filesys_disk, e->sector, e->data);
+      e->valid = true;
+    }
+  return e;
+}
+
+/* Releases entry E, obtained from cache_get(), marking it dirty
+   if DIRTY is true. */
+static void
+cache_put (struct cache_entry *e, bool dirty)
+{
+  ASSERT (e->valid);
+
+  if (dirty)
+    e->dirty = true;
+  lock_release (&e->lock);
+  unpin (e, true);
+}
+
+/* Drops a pin on E, marking it recently used if ACCESSED is
+   true. */
+static void
+unpin (struct cache_entry *e, bool accessed)
+{
+  lock_acquire (&cache_lock);
+  if (accessed)
+    e->accessed = true;
+  if (--e->pin_cnt == 0)
+    cond_broadcast (&cache_unpinned, &cache_lock);
+  lock_release (&cache_lock);
+}
+
+/* Read-ahead thread.  Reads each sector queued by
+   cache_readahead() into the cache, oldest first. */
+static void
+readahead_thread (void *aux UNUSED)
+{
+  for (;;)
+    {
+      disk_sector_t sector;
+      struct cache_entry *e;
+      bool cached;
+
+      lock_acquire (&readahead_lock);
+      while (readahead_head == readahead_tail)
+        cond_wait (&readahead_wanted, &readahead_lock);
+      sector = readahead_queue[readahead_head++ % READAHEAD_QUEUE];
+      lock_release (&readahead_lock);
+
+      lock_acquire (&cache_lock);
+      cached = lookup (sector) != NULL;
+      lock_release (&cache_lock);
+      if (cached)
+        continue;
+
+      readahead_cnt++;
+      e = cache_get (sector, true);
+      lock_release (&e->lock);
+      unpin (e, false);
+    }
+}
@@ -0,0 +1,17 @@
+#ifndef FILESYS_CACHE_H
+#define FILESYS_CACHE_H
+
+#include <stddef.h>
+#include "devices/disk.h"
+
+void cache_init (void);
+void cache_flush (void);
+void cache_print_stats (void);
+
+void cache_read (disk_sector_t, void *);
+void cache_write (disk_sector_t, const void *);
+void cache_read_at (disk_sector_t, void *, size_t ofs, size_t size);
+void cache_write_at (disk_sector_t, const void *, size_t ofs, size_t size);
+void cache_readahead (disk_sector_t);
+
+#endif /* filesys/cache.h */
@@ -1,4 +1,5 @@
 #include "filesys/directory.h"
+#include <hash.h>
 #include <stdio.h>
 #include <string.h>
 #include <list.h>
@@ -21,6 +22,60 @@ struct dir_entry
     bool in_use;                        /* In use or free? */
   };
 
+/* A directory is a file that holds an array of struct dir_entry.
+
+   A small directory is searched from the beginning, and a new
+   entry goes in the first free slot or at the end.  Once a
+   directory of DIR_LINEAR_MAX or more slots fills up, it is
+   rebuilt as an open-addressed hash table: slot 0 holds a
+   struct dir_header, and an entry named NAME goes in the first
+   free slot at or after slot 1 + hash_string(NAME) % (SLOT_CNT -
+   1), wrapping around from the last slot to slot 1.  The header
+   is marked not in use, so either way the file is an array of
+   entries to be skipped when not in use, and dir_readdir() need
+   not care which kind of directory it reads.
+
+   In a hashed directory, a slot that has never been used has an
+   empty name and ends a search.  A removed entry keeps its name,
+   so that searches continue past it, but it may be reused. */
+
+/* Number of slots at which a full directory is hashed. */
+#define DIR_LINEAR_MAX 32
+
+/* Identifies a hashed directory's header. */
+#define DIR_MAGIC 0x44495248
+
+/* Slot 0 of a hashed directory.
+   Must be the same size as struct dir_entry. */
+struct dir_header
+  {
+    uint32_t magic;                     /* DIR_MAGIC. */
+    uint32_t slot_cnt;                  /* Slots, including this one. */
+    uint32_t entry_cnt;                 /* Entries in use. */
+    uint32_t used_cnt;                  /* Entries in use or removed. */
+    char unused[NAME_MAX + 1 - 12];     /* Not used. */
+    bool in_use;                        /* Always false. */
+  };
+
+/* Reads DIR's header into *H and returns true if DIR is hashed,
+   otherwise returns false. */
+static bool
+read_header (const struct dir *dir, struct dir_header *h)
+{
+  ASSERT (sizeof *h == sizeof (struct dir_entry));
+
+  return (inode_read_at (dir->inode, h, sizeof *h, 0) == sizeof *h
+          && h->magic == DIR_MAGIC && !h->in_use);
+}
+
+/* Returns the slot in which a hashed directory of SLOT_CNT slots
+   starts searching for NAME. */
+static size_t
+home_slot (const char *name, size_t slot_cnt)
+{
+  return 1 + hash_string (name) % (slot_cnt - 1);
+}
+
 /* Creates a directory with space for ENTRY_CNT entries in the
    given SECTOR.  Returns true if successful, false on failure. */
 bool
@@ -87,28 +142,126 @@ dir_get_inode (struct dir *dir)
    If successful, returns true, sets *EP to the directory entry
    if EP is non-null, and sets *OFSP to the byte offset of the
    directory entry if OFSP is non-null.
-   otherwise, returns false and ignores EP and OFSP. */
+   otherwise, returns false and ignores EP and OFSP.
+
+   Either way, if FREE_OFSP is non-null, sets *FREE_OFSP to the
+   byte offset of the slot where an entry for NAME should be
+   added, which for a small directory may be at end of file, or
+   to -1 if a hashed directory has no free slot. */
 static bool
 lookup (const struct dir *dir, const char *name,
-        struct dir_entry *ep, off_t *ofsp) 
+        struct dir_entry *ep, off_t *ofsp, off_t *free_ofsp) 
 {
+  struct dir_header h;
   struct dir_entry e;
+  off_t free_ofs = -1;
   size_t ofs;
   
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
-  for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-       ofs += sizeof e) 
-    if (e.in_use && !strcmp (name, e.name)) 
+  if (read_header (dir, &h))
+    {
+      /* Probe from NAME's home slot until we find NAME or a slot
+         that has never been used. */
+      size_t slot = home_slot (name, h.slot_cnt);
+      size_t i;
+
+      for (i = 1; i < h.slot_cnt; i++)
+        {
+          ofs = slot * sizeof e;
+          if (inode_read_at (dir->inode, &e, sizeof e, ofs) != sizeof e)
+            break;
+          if (e.in_use && !strcmp (name, e.name))
+            goto found;
+          if (!e.in_use && free_ofs == -1)
+            free_ofs = ofs;
+          if (!e.in_use && e.name[0] == '\0')
+            break;
+          if (++slot == h.slot_cnt)
+            slot = 1;
+        }
+    }
+  else
+    {
+      /* Scan the whole directory, noting the first free slot.
+         inode_read_at() will only return a short read at end of
+         file.  Otherwise, we'd need to verify that we didn't get
+         a short read due to something intermittent such as low
+         memory. */
+      for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
+           ofs += sizeof e) 
+        if (e.in_use && !strcmp (name, e.name)) 
+          goto found;
+        else if (!e.in_use && free_ofs == -1)
+          free_ofs = ofs;
+      if (free_ofs == -1)
+        free_ofs = ofs;
+    }
+  if (free_ofsp != NULL)
+    *free_ofsp = free_ofs;
+  return false;
+
+ found:
+  if (ep != NULL)
+    *ep = e;
+  if (ofsp != NULL)
+    *ofsp = ofs;
+  if (free_ofsp != NULL)
+    *free_ofsp = free_ofs;
+  return true;
+}
+
+/* Rebuilds DIR as a hashed directory of SLOT_CNT slots, which
+   must be at least as many as it has now.  Returns true if
+   successful, false if memory or disk space runs out, in which
+   case DIR still works as before. */
+static bool
+hash_dir (struct dir *dir, size_t slot_cnt)
+{
+  off_t old_size = inode_length (dir->inode);
+  off_t size = slot_cnt * sizeof (struct dir_entry);
+  struct dir_entry *old, *table;
+  struct dir_header h;
+  bool success = false;
+  size_t i;
+
+  ASSERT (old_size <= size);
+
+  old = malloc (old_size);
+  table = calloc (slot_cnt, sizeof *table);
+  if (old == NULL || table == NULL
+      || inode_read_at (dir->inode, old, old_size, 0) != old_size)
+    goto done;
+
+  /* Extend the directory with free slots first, so that running
+     out of disk space leaves it unchanged. */
+  if (inode_write_at (dir->inode, table + old_size / sizeof *table,
+                      size - old_size, old_size) != size - old_size)
+    goto done;
+
+  memset (&h, 0, sizeof h);
+  h.magic = DIR_MAGIC;
+  h.slot_cnt = slot_cnt;
+  for (i = 0; i < old_size / sizeof *old; i++)
+    if (old[i].in_use)
       {
-        if (ep != NULL)
-          *ep = e;
-        if (ofsp != NULL)
-          *ofsp = ofs;
-        return true;
+        size_t slot = home_slot (old[i].name, slot_cnt);
+        while (table[slot].in_use)
+          if (++slot == slot_cnt)
+            slot = 1;
+        table[slot] = old[i];
+        h.entry_cnt++;
       }
-  return false;
+  h.used_cnt = h.entry_cnt;
+  memcpy (&table[0], &h, sizeof h);
+
+  success = inode_write_at (dir->inode, table, size, 0) == size;
+
+ done:
+  free (old);
+  free (table);
+  return success;
 }
 
 /* Searches DIR for a file with the given NAME
@@ -124,7 +277,7 @@ dir_lookup (const struct dir *dir, const char *name,
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
-  if (lookup (dir, name, &e, NULL))
+  if (lookup (dir, name, &e, NULL, NULL))
     *inode = inode_open (e.inode_sector);
   else
     *inode = NULL;
@@ -141,8 +294,10 @@ dir_lookup (const struct dir *dir, const char *name,
 bool
 dir_add (struct dir *dir, const char *name, disk_sector_t inode_sector) 
 {
+  struct dir_header h;
   struct dir_entry e;
   off_t ofs;
+  bool hashed;
   bool success = false;
   
   ASSERT (dir != NULL);
@@ -152,28 +307,55 @@ dir_add (struct dir *dir, const char *name, disk_sector_t inode_sector)
   if (*name == '\0' || strlen (name) > NAME_MAX)
     return false;
 
-  /* Check that NAME is not in use. */
-  if (lookup (dir, name, NULL, NULL))
+  /* Check that NAME is not in use, and set OFS to the offset of
+     the slot for it.  In a small directory with no free slots,
+     that is the current end-of-file. */
+  if (lookup (dir, name, NULL, NULL, &ofs))
     goto done;
 
-  /* Set OFS to offset of free slot.
-     If there are no free slots, then it will be set to the
-     current end-of-file.
-     
-     inode_read_at() will only return a short read at end of file.
-     Otherwise, we'd need to verify that we didn't get a short
-     read due to something intermittent such as low memory. */
-  for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-       ofs += sizeof e) 
-    if (!e.in_use)
-      break;
+  /* Hash a small directory that has filled up, and rebuild a
+     hashed one that is more than 3/4 used, doubling its size if
+     more than half of it is live entries.  If that fails, carry
+     on in the slot we have, if any. */
+  hashed = read_header (dir, &h);
+  if (!hashed && ofs == inode_length (dir->inode)
+      && ofs / sizeof e >= DIR_LINEAR_MAX)
+    {
+      if (hash_dir (dir, 2 * (ofs / sizeof e)))
+        lookup (dir, name, NULL, NULL, &ofs);
+    }
+  else if (hashed && (h.used_cnt + 1) * 4 > (h.slot_cnt - 1) * 3)
+    {
+      size_t slot_cnt = h.slot_cnt;
+      if ((h.entry_cnt + 1) * 2 > slot_cnt - 1)
+        slot_cnt *= 2;
+      if (hash_dir (dir, slot_cnt))
+        lookup (dir, name, NULL, NULL, &ofs);
+    }
+  if (ofs == -1)
+    goto done;
+
+  /* Note whether this uses a slot that has never been used. */
+  hashed = read_header (dir, &h);
+  if (hashed
+      && (inode_read_at (dir->inode, &e, sizeof e, ofs) != sizeof e
+          || e.name[0] == '\0'))
+    h.used_cnt++;
 
   /* Write slot. */
+  memset (&e, 0, sizeof e);
   e.in_use = true;
   strlcpy (e.name, name, sizeof e.name);
   e.inode_sector = inode_sector;
   success = inode_write_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
 
+  /* Update the header. */
+  if (success && hashed)
+    {
+      h.entry_cnt++;
+      inode_write_at (dir->inode, &h, sizeof h, 0);
+    }
+
  done:
   return success;
 }
@@ -184,6 +366,7 @@ dir_add (struct dir *dir, const char *name, disk_sector_t inode_sector)
 bool
 dir_remove (struct dir *dir, const char *name) 
 {
+  struct dir_header h;
   struct dir_entry e;
   struct inode *inode = NULL;
   bool success = false;
@@ -193,7 +376,7 @@ dir_remove (struct dir *dir, const char *name)
   ASSERT (name != NULL);
 
   /* Find directory entry. */
-  if (!lookup (dir, name, &e, &ofs))
+  if (!lookup (dir, name, &e, &ofs, NULL))
     goto done;
 
   /* Open inode. */
@@ -201,10 +384,16 @@ dir_remove (struct dir *dir, const char *name)
   if (inode == NULL)
     goto done;
 
-  /* Erase directory entry. */
+  /* Erase directory entry.  It keeps its name, which a hashed
+     directory needs to search past it. */
   e.in_use = false;
   if (inode_write_at (dir->inode, &e, sizeof e, ofs) != sizeof e) 
     goto done;
+  if (read_header (dir, &h))
+    {
+      h.entry_cnt--;
+      inode_write_at (dir->inode, &h, sizeof h, 0);
+    }
 
   /* Remove inode. */
   inode_remove (inode);
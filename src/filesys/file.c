@@ -1,7 +1,7 @@
 #include "filesys/file.h"
 #include <debug.h>
 #include "filesys/inode.h"
-#include "threads/malloc.h"
+#include "threads/slab.h"
 
 /* An open file. */
 struct file 
@@ -9,26 +9,50 @@ struct file
     struct inode *inode;        /* File's inode. */
     off_t pos;                  /* Current position. */
     bool deny_write;            /* Has file_deny_write() been called? */
+
+    /* Read-ahead state.  See readahead(). */
+    off_t ra_next;              /* Offset where a sequential read resumes. */
+    off_t ra_end;               /* End of data already read ahead. */
+    off_t ra_window;            /* Bytes to stay ahead, 0 if not streaming. */
   };
 
+/* Read-ahead window sizes, in bytes. */
+#define RA_MIN (4 * DISK_SECTOR_SIZE)
+#define RA_MAX (64 * DISK_SECTOR_SIZE)
+
+/* Cache of struct files. */
+static struct kmem_cache file_cache;
+
+static void readahead (struct file *, off_t offset, off_t bytes_read);
+
+/* Initializes the file module. */
+void
+file_init (void) 
+{
+  kmem_cache_init (&file_cache, "file", sizeof (struct file), NULL);
+}
+
 /* Opens a file for the given INODE, of which it takes ownership,
    and returns the new file.  Returns a null pointer if an
    allocation fails or if INODE is null. */
 struct file *
 file_open (struct inode *inode) 
 {
-  struct file *file = calloc (1, sizeof *file);
+  struct file *file = kmem_cache_alloc (&file_cache);
   if (inode != NULL && file != NULL)
     {
       file->inode = inode;
       file->pos = 0;
       file->deny_write = false;
+      file->ra_next = 0;
+      file->ra_end = 0;
+      file->ra_window = 0;
       return file;
     }
   else
     {
       inode_close (inode);
-      free (file);
+      kmem_cache_free (&file_cache, file);
       return NULL; 
     }
 }
@@ -49,7 +73,7 @@ file_close (struct file *file)
     {
       file_allow_write (file);
       inode_close (file->inode);
-      free (file); 
+      kmem_cache_free (&file_cache, file); 
     }
 }
 
@@ -69,6 +93,7 @@ off_t
 file_read (struct file *file, void *buffer, off_t size) 
 {
   off_t bytes_read = inode_read_at (file->inode, buffer, size, file->pos);
+  readahead (file, file->pos, bytes_read);
   file->pos += bytes_read;
   return bytes_read;
 }
@@ -81,15 +106,16 @@ file_read (struct file *file, void *buffer, off_t size)
 off_t
 file_read_at (struct file *file, void *buffer, off_t size, off_t file_ofs) 
 {
-  return inode_read_at (file->inode, buffer, size, file_ofs);
+  off_t bytes_read = inode_read_at (file->inode, buffer, size, file_ofs);
+  readahead (file, file_ofs, bytes_read);
+  return bytes_read;
 }
 
 /* Writes SIZE bytes from BUFFER into FILE,
    starting at the file's current position.
    Returns the number of bytes actually written,
-   which may be less than SIZE if end of file is reached.
-   (Normally we'd grow the file in that case, but file growth is
-   not yet implemented.)
+   which may be less than SIZE if the disk fills up.
+   Writing past end of file extends the file.
    Advances FILE's position by the number of bytes read. */
 off_t
 file_write (struct file *file, const void *buffer, off_t size) 
@@ -102,9 +128,8 @@ file_write (struct file *file, const void *buffer, off_t size)
 /* Writes SIZE bytes from BUFFER into FILE,
    starting at offset FILE_OFS in the file.
    Returns the number of bytes actually written,
-   which may be less than SIZE if end of file is reached.
-   (Normally we'd grow the file in that case, but file growth is
-   not yet implemented.)
+   which may be less than SIZE if the disk fills up.
+   Writing past end of file extends the file.
    The file's current position is unaffected. */
 off_t
 file_write_at (struct file *file, const void *buffer, off_t size,
@@ -166,3 +191,43 @@ file_tell (struct file *file)
   ASSERT (file != NULL);
   return file->pos;
 }
+
+/* Notes that BYTES_READ bytes were just read from FILE at
+   OFFSET and, if FILE is being read sequentially, starts reading
+   the data that follows into the buffer cache.
+
+   A read that begins where the previous one ended continues a
+   stream.  Each such read doubles the read-ahead window, from
+   RA_MIN up to RA_MAX bytes, and any other read resets it.
+   Read-ahead is only requested for the part of the window past
+   what has already been requested, so a streaming reader mostly
+   finds its data in the cache and asks for more only as it
+   moves forward. */
+static void
+readahead (struct file *file, off_t offset, off_t bytes_read) 
+{
+  if (bytes_read <= 0)
+    return;
+
+  if (offset == file->ra_next)
+    {
+      file->ra_window = (file->ra_window == 0 ? RA_MIN
+                         : file->ra_window * 2 < RA_MAX ? file->ra_window * 2
+                         : RA_MAX);
+      if (file->ra_end < offset + bytes_read)
+        file->ra_end = offset + bytes_read;
+    }
+  else
+    {
+      file->ra_window = 0;
+      file->ra_end = 0;
+    }
+  file->ra_next = offset + bytes_read;
+
+  if (file->ra_window > 0 && file->ra_end < file->ra_next + file->ra_window)
+    {
+      off_t end = file->ra_next + file->ra_window;
+      inode_readahead (file->inode, end - file->ra_end, file->ra_end);
+      file->ra_end = end;
+    }
+}
@@ -1,22 +1,94 @@
 #include "filesys/free-map.h"
 #include <bitmap.h>
 #include <debug.h>
+#include <rbtree.h>
+#include <round.h>
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
+
+/* Free map.
+
+   The bitmap, one bit per disk sector, is what goes on disk.
+   Searching it for free sectors is slow, though, so we also keep
+   the free sectors in memory as a set of extents, maximal runs
+   of free sectors.  Each extent is in two trees: one ordered by
+   starting sector, for finding the neighbors that a released run
+   merges with, and one ordered by length, for finding the
+   smallest extent that satisfies an allocation (best fit).
+
+   Files grow one sector at a time, and best fit would scatter
+   those sectors into whatever small holes are left.  Instead, a
+   single sector is allocated next fit: the first free sector at
+   or after the one allocated last time, found in the tree
+   ordered by starting sector, so that consecutive allocations
+   end up next to each other.  Only when no free sector follows
+   it do we fall back to best fit.
+
+   Rewriting the whole bitmap file on every allocation and
+   release would make creating a file cost several full rewrites.
+   Instead, we only note which sectors of the bitmap file have
+   changed, and write just those back when the free map is
+   closed. */
 
 static struct file *free_map_file;   /* Free map file. */
 static struct bitmap *free_map;      /* Free map, one bit per disk sector. */
+static struct lock free_map_lock;    /* Protects everything here. */
+
+/* Sectors of the free map file that differ from the bitmap on
+   disk, one bit per sector. */
+static struct bitmap *dirty_sectors;
+
+/* Number of free map bits in a sector of the free map file. */
+#define BITS_PER_SECTOR (DISK_SECTOR_SIZE * 8)
+
+/* A run of free sectors. */
+struct extent
+  {
+    struct rb_elem start_elem;  /* Element in `by_start'. */
+    struct rb_elem length_elem; /* Element in `by_length'. */
+    disk_sector_t start;        /* First sector. */
+    size_t length;              /* Number of sectors. */
+  };
+
+static struct rbtree by_start;       /* Extents, by starting sector. */
+static struct rbtree by_length;      /* Extents, by length. */
+static struct kmem_cache extent_cache;
+
+/* Where the next single-sector allocation starts looking. */
+static disk_sector_t next_sector;
+
+static rb_less_func start_less, length_less;
+static void build_extents (void);
+static struct rb_elem *extent_at_or_after (disk_sector_t);
+static void remove_free (disk_sector_t, size_t);
+static void add_free (disk_sector_t, size_t);
+static void mark_dirty (disk_sector_t, size_t);
 
 /* Initializes the free map. */
 void
-free_map_init (void) 
+free_map_init (void)
 {
+  size_t sector_cnt;
+
   free_map = bitmap_create (disk_size (filesys_disk));
   if (free_map == NULL)
     PANIC ("bitmap creation failed--disk is too large");
   bitmap_mark (free_map, FREE_MAP_SECTOR);
   bitmap_mark (free_map, ROOT_DIR_SECTOR);
+
+  sector_cnt = DIV_ROUND_UP (bitmap_file_size (free_map), DISK_SECTOR_SIZE);
+  dirty_sectors = bitmap_create (sector_cnt);
+  if (dirty_sectors == NULL)
+    PANIC ("bitmap creation failed--disk is too large");
+
+  lock_init_named (&free_map_lock, "free-map");
+  kmem_cache_init (&extent_cache, "extent", sizeof (struct extent), NULL);
+  rb_init (&by_start, start_less, NULL);
+  rb_init (&by_length, length_less, NULL);
+  build_extents ();
 }
 
 /* Allocates CNT consecutive sectors from the free map and stores
@@ -24,52 +96,91 @@ free_map_init (void)
    Returns true if successful, false if all sectors were
    available. */
 bool
-free_map_allocate (size_t cnt, disk_sector_t *sectorp) 
+free_map_allocate (size_t cnt, disk_sector_t *sectorp)
 {
-  disk_sector_t sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
-  if (sector != BITMAP_ERROR
-      && free_map_file != NULL
-      && !bitmap_write (free_map, free_map_file))
+  struct extent key;
+  struct rb_elem *e;
+  disk_sector_t sector = 0;
+  bool success = false;
+
+  lock_acquire (&free_map_lock);
+  e = cnt == 1 ? extent_at_or_after (next_sector) : NULL;
+  if (e != NULL)
+    {
+      /* Next fit. */
+      struct extent *x = rb_entry (e, struct extent, start_elem);
+      sector = x->start > next_sector ? x->start : next_sector;
+    }
+  else
+    {
+      /* Best fit. */
+      key.start = 0;
+      key.length = cnt;
+      e = rb_lower_bound (&by_length, &key.length_elem);
+      if (e != NULL)
+        sector = rb_entry (e, struct extent, length_elem)->start;
+    }
+
+  if (e != NULL)
     {
-      bitmap_set_multiple (free_map, sector, cnt, false); 
-      sector = BITMAP_ERROR;
+      ASSERT (bitmap_none (free_map, sector, cnt));
+      bitmap_set_multiple (free_map, sector, cnt, true);
+      remove_free (sector, cnt);
+      mark_dirty (sector, cnt);
+      if (cnt == 1)
+        next_sector = sector + 1;
+      *sectorp = sector;
+      success = true;
     }
-  if (sector != BITMAP_ERROR)
-    *sectorp = sector;
-  return sector != BITMAP_ERROR;
+  lock_release (&free_map_lock);
+  return success;
 }
 
 /* Makes CNT sectors starting at SECTOR available for use. */
 void
 free_map_release (disk_sector_t sector, size_t cnt)
 {
+  lock_acquire (&free_map_lock);
   ASSERT (bitmap_all (free_map, sector, cnt));
   bitmap_set_multiple (free_map, sector, cnt, false);
-  bitmap_write (free_map, free_map_file);
+  add_free (sector, cnt);
+  mark_dirty (sector, cnt);
+  lock_release (&free_map_lock);
 }
 
 /* Opens the free map file and reads it from disk. */
 void
-free_map_open (void) 
+free_map_open (void)
 {
   free_map_file = file_open (inode_open (FREE_MAP_SECTOR));
   if (free_map_file == NULL)
     PANIC ("can't open free map");
   if (!bitmap_read (free_map, free_map_file))
     PANIC ("can't read free map");
+  bitmap_set_all (dirty_sectors, false);
+  build_extents ();
 }
 
 /* Writes the free map to disk and closes the free map file. */
 void
-free_map_close (void) 
+free_map_close (void)
 {
+  size_t i;
+
+  for (i = 0; i < bitmap_size (dirty_sectors); i++)
+    if (bitmap_test (dirty_sectors, i)
+        && !bitmap_write_part (free_map, free_map_file,
+                               i * DISK_SECTOR_SIZE, DISK_SECTOR_SIZE))
+      PANIC ("can't write free map");
+  bitmap_set_all (dirty_sectors, false);
   file_close (free_map_file);
+  free_map_file = NULL;
 }
 
 /* Creates a new free map file on disk and writes the free map to
    it. */
 void
-free_map_create (void) 
+free_map_create (void)
 {
   /* Create inode. */
   if (!inode_create (FREE_MAP_SECTOR, bitmap_file_size (free_map)))
@@ -81,4 +192,196 @@ free_map_create (void)
     PANIC ("can't open free map");
   if (!bitmap_write (free_map, free_map_file))
     PANIC ("can't write free map");
+  bitmap_set_all (dirty_sectors, false);
+}
+
+/* Orders extents by starting sector. */
+static bool
+start_less (const struct rb_elem *a_, const struct rb_elem *b_,
+            void *aux UNUSED)
+{
+  const struct extent *a = rb_entry (a_, struct extent, start_elem);
+  const struct extent *b = rb_entry (b_, struct extent, start_elem);
+
+  return a->start < b->start;
+}
+
+/* Orders extents by length, and then by starting sector, so that
+   among extents of the best length we allocate the one nearest
+   the start of the disk. */
+static bool
+length_less (const struct rb_elem *a_, const struct rb_elem *b_,
+             void *aux UNUSED)
+{
+  const struct extent *a = rb_entry (a_, struct extent, length_elem);
+  const struct extent *b = rb_entry (b_, struct extent, length_elem);
+
+  return a->length < b->length
+         || (a->length == b->length && a->start < b->start);
+}
+
+/* Creates an extent for START...START + LENGTH - 1 and adds it to
+   both trees.  If memory is short, the run stays free in the
+   bitmap but is not used again until the free map is next
+   read. */
+static void
+insert_extent (disk_sector_t start, size_t length)
+{
+  struct extent *x = kmem_cache_alloc (&extent_cache);
+  if (x != NULL)
+    {
+      x->start = start;
+      x->length = length;
+      rb_insert (&by_start, &x->start_elem);
+      rb_insert (&by_length, &x->length_elem);
+    }
+}
+
+/* Removes extent X from both trees and frees it. */
+static void
+delete_extent (struct extent *x)
+{
+  rb_remove (&by_start, &x->start_elem);
+  rb_remove (&by_length, &x->length_elem);
+  kmem_cache_free (&extent_cache, x);
+}
+
+/* Discards all the extents and rebuilds them from the bitmap. */
+static void
+build_extents (void)
+{
+  size_t bit_cnt = bitmap_size (free_map);
+  size_t start, end;
+
+  while (!rb_empty (&by_start))
+    delete_extent (rb_entry (rb_min (&by_start), struct extent, start_elem));
+
+  for (start = bitmap_scan (free_map, 0, 1, false); start != BITMAP_ERROR;
+       start = end < bit_cnt ? bitmap_scan (free_map, end, 1, false)
+                             : BITMAP_ERROR)
+    {
+      end = bitmap_scan (free_map, start, 1, true);
+      if (end == BITMAP_ERROR)
+        end = bit_cnt;
+      insert_extent (start, end - start);
+    }
+}
+
+/* Returns the extent that contains SECTOR, or the one that
+   follows it if none does, or a null pointer if there is no
+   such extent. */
+static struct rb_elem *
+extent_at_or_after (disk_sector_t sector)
+{
+  struct extent key;
+  struct rb_elem *e;
+
+  key.start = sector;
+  e = rb_lower_bound (&by_start, &key.start_elem);
+  if (e == NULL || rb_entry (e, struct extent, start_elem)->start != sector)
+    {
+      struct rb_elem *prev = e != NULL ? rb_prev (e) : rb_max (&by_start);
+      if (prev != NULL)
+        {
+          struct extent *x = rb_entry (prev, struct extent, start_elem);
+          if (sector < x->start + x->length)
+            e = prev;
+        }
+    }
+  return e;
+}
+
+/* Takes the CNT sectors starting at SECTOR out of the extent
+   that contains them. */
+static void
+remove_free (disk_sector_t sector, size_t cnt)
+{
+  struct extent *x = rb_entry (extent_at_or_after (sector),
+                               struct extent, start_elem);
+  disk_sector_t end = x->start + x->length;
+
+  ASSERT (x->start <= sector && sector + cnt <= end);
+  if (x->start == sector && x->length == cnt)
+    delete_extent (x);
+  else if (x->start == sector)
+    {
+      /* Shrinking X from the front keeps its place in
+         `by_start', but not in `by_length'. */
+      rb_remove (&by_length, &x->length_elem);
+      x->start += cnt;
+      x->length -= cnt;
+      rb_insert (&by_length, &x->length_elem);
+    }
+  else
+    {
+      /* Keep the part before SECTOR in X, whose start does not
+         change, and make the part after the run a new extent. */
+      rb_remove (&by_length, &x->length_elem);
+      x->length = sector - x->start;
+      rb_insert (&by_length, &x->length_elem);
+      if (sector + cnt < end)
+        insert_extent (sector + cnt, end - (sector + cnt));
+    }
+}
+
+/* Adds the CNT sectors starting at SECTOR, which must not be in
+   any extent, merging them with the extents on either side if
+   they are adjacent. */
+static void
+add_free (disk_sector_t sector, size_t cnt)
+{
+  struct rb_elem *next_elem = extent_at_or_after (sector);
+  struct rb_elem *prev_elem = (next_elem != NULL ? rb_prev (next_elem)
+                               : rb_max (&by_start));
+  struct extent *next = NULL, *prev = NULL;
+
+  if (next_elem != NULL)
+    {
+      next = rb_entry (next_elem, struct extent, start_elem);
+      ASSERT (next->start >= sector + cnt);
+      if (next->start != sector + cnt)
+        next = NULL;
+    }
+  if (prev_elem != NULL)
+    {
+      prev = rb_entry (prev_elem, struct extent, start_elem);
+      ASSERT (prev->start + prev->length <= sector);
+      if (prev->start + prev->length != sector)
+        prev = NULL;
+    }
+
+  if (prev != NULL)
+    {
+      /* Grow PREV forward, absorbing NEXT if it adjoins too. */
+      rb_remove (&by_length, &prev->length_elem);
+      prev->length += cnt;
+      if (next != NULL)
+        {
+          prev->length += next->length;
+          delete_extent (next);
+        }
+      rb_insert (&by_length, &prev->length_elem);
+    }
+  else if (next != NULL)
+    {
+      /* Grow NEXT backward.  Its place in `by_start' does not
+         change, because nothing lies between SECTOR and it. */
+      rb_remove (&by_length, &next->length_elem);
+      next->start = sector;
+      next->length += cnt;
+      rb_insert (&by_length, &next->length_elem);
+    }
+  else
+    insert_extent (sector, cnt);
+}
+
+/* Notes that the free map file sectors holding the bits for the
+   CNT sectors starting at SECTOR need to be written back. */
+static void
+mark_dirty (disk_sector_t sector, size_t cnt)
+{
+  size_t first = sector / BITS_PER_SECTOR;
+  size_t last = (sector + cnt - 1) / BITS_PER_SECTOR;
+
+  bitmap_set_multiple (dirty_sectors, first, last - first + 1, true);
 }
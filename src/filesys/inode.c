@@ -3,21 +3,46 @@
 #include <debug.h>
 #include <round.h>
 #include <string.h>
+#include "filesys/cache.h"
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
 
+/* Number of sector numbers in the inode itself, and in an
+   indirect block. */
+#define DIRECT_CNT 124
+#define PTRS_PER_SECTOR ((off_t) (DISK_SECTOR_SIZE / sizeof (disk_sector_t)))
+
+/* Largest possible file, in bytes. */
+#define MAX_LENGTH ((DIRECT_CNT + PTRS_PER_SECTOR                    \
+                     + PTRS_PER_SECTOR * PTRS_PER_SECTOR)            \
+                    * DISK_SECTOR_SIZE)
+
 /* On-disk inode.
-   Must be exactly DISK_SECTOR_SIZE bytes long. */
+   Must be exactly DISK_SECTOR_SIZE bytes long.
+
+   A file's data sectors are found through a multilevel index.
+   The first DIRECT_CNT sectors are listed in the inode itself.
+   The next PTRS_PER_SECTOR are listed in the indirect block, a
+   sector full of sector numbers.  The rest are listed in blocks
+   that are listed in turn in the doubly indirect block.  A
+   sector number of 0 means that the data sector, or the index
+   block, has not been allocated, which is never ambiguous
+   because sector 0 always holds the free map's inode.  Such a
+   hole reads as zeros; the sector is allocated when it is first
+   written. */
 struct inode_disk
   {
-    disk_sector_t start;                /* First data sector. */
     off_t length;                       /* File size in bytes. */
     unsigned magic;                     /* Magic number. */
-    uint32_t unused[125];               /* Not used. */
+    disk_sector_t direct[DIRECT_CNT];   /* Direct data sectors. */
+    disk_sector_t indirect;             /* Indirect block. */
+    disk_sector_t doubly_indirect;      /* Doubly indirect block. */
   };
 
 /* Returns the number of sectors to allocate for an inode SIZE
@@ -28,6 +53,10 @@ bytes_to_sectors (off_t size)
   return DIV_ROUND_UP (size, DISK_SECTOR_SIZE);
 }
 
+static disk_sector_t index_to_sector (struct inode_disk *, size_t idx,
+                                      bool create, bool *dirty);
+static void deallocate (struct inode_disk *);
+
 /* In-memory inode. */
 struct inode 
   {
@@ -36,32 +65,39 @@ struct inode
     int open_cnt;                       /* Number of openers. */
     bool removed;                       /* True if deleted, false otherwise. */
     int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
+    struct lock grow_lock;              /* Serializes allocating writes. */
     struct inode_disk data;             /* Inode content. */
   };
 
 /* Returns the disk sector that contains byte offset POS within
    INODE.
-   Returns -1 if INODE does not contain data for a byte at offset
-   POS. */
+   Returns 0 if INODE does not contain data for a byte at offset
+   POS, either because POS is past the end of the file or because
+   it falls in a hole. */
 static disk_sector_t
-byte_to_sector (const struct inode *inode, off_t pos) 
+byte_to_sector (struct inode *inode, off_t pos) 
 {
   ASSERT (inode != NULL);
   if (pos < inode->data.length)
-    return inode->data.start + pos / DISK_SECTOR_SIZE;
+    return index_to_sector (&inode->data, pos / DISK_SECTOR_SIZE,
+                            false, NULL);
   else
-    return -1;
+    return 0;
 }
 
 /* List of open inodes, so that opening a single inode twice
    returns the same `struct inode'. */
 static struct list open_inodes;
 
+/* Cache of in-memory inodes. */
+static struct kmem_cache inode_cache;
+
 /* Initializes the inode module. */
 void
 inode_init (void) 
 {
   list_init (&open_inodes);
+  kmem_cache_init (&inode_cache, "inode", sizeof (struct inode), NULL);
 }
 
 /* Initializes an inode with LENGTH bytes of data and
@@ -81,25 +117,31 @@ inode_create (disk_sector_t sector, off_t length)
      one sector in size, and you should fix that. */
   ASSERT (sizeof *disk_inode == DISK_SECTOR_SIZE);
 
+  if (length > MAX_LENGTH)
+    return false;
+
   disk_inode = calloc (1, sizeof *disk_inode);
   if (disk_inode != NULL)
     {
       size_t sectors = bytes_to_sectors (length);
+      size_t i;
+
+      /* Allocate the initial data sectors up front, so that a
+         file created with a given size cannot later fail to fill
+         it for lack of space. */
       disk_inode->length = length;
       disk_inode->magic = INODE_MAGIC;
-      if (free_map_allocate (sectors, &disk_inode->start))
+      for (i = 0; i < sectors; i++)
+        if (index_to_sector (disk_inode, i, true, NULL) == 0)
+          break;
+
+      if (i == sectors)
         {
-          disk_write (filesys_disk, sector, disk_inode);
-          if (sectors > 0) 
-            {
-              static char zeros[DISK_SECTOR_SIZE];
-              size_t i;
-              
-              for (i = 0; i < sectors; i++) 
-                disk_write (filesys_disk, disk_inode->start + i, zeros); 
-            }
+          cache_write (sector, disk_inode);
           success = true; 
-        } 
+        }
+      else
+        deallocate (disk_inode);
       free (disk_inode);
     }
   return success;
@@ -127,7 +169,7 @@ inode_open (disk_sector_t sector)
     }
 
   /* Allocate memory. */
-  inode = malloc (sizeof *inode);
+  inode = kmem_cache_alloc (&inode_cache);
   if (inode == NULL)
     return NULL;
 
@@ -137,7 +179,8 @@ inode_open (disk_sector_t sector)
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
   inode->removed = false;
-  disk_read (filesys_disk, inode->sector, &inode->data);
+  lock_init (&inode->grow_lock);
+  cache_read (inode->sector, &inode->data);
   return inode;
 }
 
@@ -177,11 +220,10 @@ inode_close (struct inode *inode)
       if (inode->removed) 
         {
           free_map_release (inode->sector, 1);
-          free_map_release (inode->data.start,
-                            bytes_to_sectors (inode->data.length)); 
+          deallocate (&inode->data);
         }
 
-      free (inode); 
+      kmem_cache_free (&inode_cache, inode); 
     }
 }
 
@@ -202,7 +244,6 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
 {
   uint8_t *buffer = buffer_;
   off_t bytes_read = 0;
-  uint8_t *bounce = NULL;
 
   while (size > 0) 
     {
@@ -220,59 +261,74 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
       if (chunk_size <= 0)
         break;
 
-      if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE) 
-        {
-          /* Read full sector directly into caller's buffer. */
-          disk_read (filesys_disk, sector_idx, buffer + bytes_read); 
-        }
-      else 
-        {
-          /* Read sector into bounce buffer, then partially copy
-             into caller's buffer. */
-          if (bounce == NULL) 
-            {
-              bounce = malloc (DISK_SECTOR_SIZE);
-              if (bounce == NULL)
-                break;
-            }
-          disk_read (filesys_disk, sector_idx, bounce);
-          memcpy (buffer + bytes_read, bounce + sector_ofs, chunk_size);
-        }
+      /* Copy out of the buffer cache, or zeros for a hole. */
+      if (sector_idx != 0)
+        cache_read_at (sector_idx, buffer + bytes_read, sector_ofs,
+                       chunk_size);
+      else
+        memset (buffer + bytes_read, 0, chunk_size);
       
       /* Advance. */
       size -= chunk_size;
       offset += chunk_size;
       bytes_read += chunk_size;
     }
-  free (bounce);
 
   return bytes_read;
 }
 
+/* Starts reading the sectors that hold the SIZE bytes of INODE
+   at OFFSET into the buffer cache in the background, as far as
+   they lie within INODE's length. */
+void
+inode_readahead (struct inode *inode, off_t size, off_t offset) 
+{
+  off_t end = offset + size;
+
+  if (end > inode_length (inode))
+    end = inode_length (inode);
+  for (offset -= offset % DISK_SECTOR_SIZE; offset < end;
+       offset += DISK_SECTOR_SIZE)
+    {
+      disk_sector_t sector = byte_to_sector (inode, offset);
+      if (sector != 0)
+        cache_readahead (sector);
+    }
+}
+
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
    Returns the number of bytes actually written, which may be
-   less than SIZE if end of file is reached or an error occurs.
-   (Normally a write at end of file would extend the inode, but
-   growth is not yet implemented.) */
+   less than SIZE if the disk fills up or the file reaches its
+   maximum size.
+
+   A write past end of file extends the inode.  Data sectors are
+   allocated only as they are written, so any gap between the old
+   end of file and OFFSET is left as a hole that reads as
+   zeros. */
 off_t
 inode_write_at (struct inode *inode, const void *buffer_, off_t size,
                 off_t offset) 
 {
   const uint8_t *buffer = buffer_;
   off_t bytes_written = 0;
-  uint8_t *bounce = NULL;
+  bool dirty = false;
 
   if (inode->deny_write_cnt)
     return 0;
 
+  /* Writers to one inode take turns, so that two of them cannot
+     allocate the same sector or index block twice. */
+  lock_acquire (&inode->grow_lock);
   while (size > 0) 
     {
-      /* Sector to write, starting byte offset within sector. */
-      disk_sector_t sector_idx = byte_to_sector (inode, offset);
+      /* Sector to write, starting byte offset within sector.
+         Allocates the sector if it is not there yet. */
+      disk_sector_t sector_idx;
       int sector_ofs = offset % DISK_SECTOR_SIZE;
 
-      /* Bytes left in inode, bytes left in sector, lesser of the two. */
-      off_t inode_left = inode_length (inode) - offset;
+      /* Bytes left before the maximum file size, bytes left in
+         sector, lesser of the two. */
+      off_t inode_left = MAX_LENGTH - offset;
       int sector_left = DISK_SECTOR_SIZE - sector_ofs;
       int min_left = inode_left < sector_left ? inode_left : sector_left;
 
@@ -281,38 +337,31 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
       if (chunk_size <= 0)
         break;
 
-      if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE) 
-        {
-          /* Write full sector directly to disk. */
-          disk_write (filesys_disk, sector_idx, buffer + bytes_written); 
-        }
-      else 
-        {
-          /* We need a bounce buffer. */
-          if (bounce == NULL) 
-            {
-              bounce = malloc (DISK_SECTOR_SIZE);
-              if (bounce == NULL)
-                break;
-            }
-
-          /* If the sector contains data before or after the chunk
-             we're writing, then we need to read in the sector
-             first.  Otherwise we start with a sector of all zeros. */
-          if (sector_ofs > 0 || chunk_size < sector_left) 
-            disk_read (filesys_disk, sector_idx, bounce);
-          else
-            memset (bounce, 0, DISK_SECTOR_SIZE);
-          memcpy (bounce + sector_ofs, buffer + bytes_written, chunk_size);
-          disk_write (filesys_disk, sector_idx, bounce); 
-        }
+      sector_idx = index_to_sector (&inode->data, offset / DISK_SECTOR_SIZE,
+                                    true, &dirty);
+      if (sector_idx == 0)
+        break;
+
+      /* Copy into the buffer cache, which reads in the rest of
+         the sector first if this is a partial write. */
+      cache_write_at (sector_idx, buffer + bytes_written,
+                      sector_ofs, chunk_size);
 
       /* Advance. */
       size -= chunk_size;
       offset += chunk_size;
       bytes_written += chunk_size;
     }
-  free (bounce);
+
+  /* Extend the file, and write back the inode if it changed. */
+  if (offset > inode->data.length)
+    {
+      inode->data.length = offset;
+      dirty = true;
+    }
+  if (dirty)
+    cache_write (inode->sector, &inode->data);
+  lock_release (&inode->grow_lock);
 
   return bytes_written;
 }
@@ -343,3 +392,123 @@ inode_length (const struct inode *inode)
 {
   return inode->data.length;
 }
+
+/* Allocates a sector, fills it with zeros, and returns it, or
+   returns 0 if the disk is full. */
+static disk_sector_t
+allocate_zeroed (void) 
+{
+  static char zeros[DISK_SECTOR_SIZE];
+  disk_sector_t sector;
+
+  if (!free_map_allocate (1, &sector))
+    return 0;
+  cache_write (sector, zeros);
+  return sector;
+}
+
+/* Returns the sector number stored in *SLOTP, a slot in an
+   on-disk inode.  If it is 0 and CREATE is true, first allocates
+   a zeroed sector, stores it in *SLOTP, and sets *DIRTY to true
+   if DIRTY is nonnull.  Returns 0 if there is no sector. */
+static disk_sector_t
+inode_slot (disk_sector_t *slotp, bool create, bool *dirty) 
+{
+  if (*slotp == 0 && create)
+    {
+      *slotp = allocate_zeroed ();
+      if (*slotp != 0 && dirty != NULL)
+        *dirty = true;
+    }
+  return *slotp;
+}
+
+/* Returns the sector number stored in slot IDX of index block
+   BLOCK.  If it is 0 and CREATE is true, first allocates a
+   zeroed sector and stores it in the slot.  Returns 0 if there
+   is no sector. */
+static disk_sector_t
+block_slot (disk_sector_t block, off_t idx, bool create) 
+{
+  disk_sector_t sector;
+
+  cache_read_at (block, &sector, idx * sizeof sector, sizeof sector);
+  if (sector == 0 && create)
+    {
+      sector = allocate_zeroed ();
+      if (sector != 0)
+        cache_write_at (block, &sector, idx * sizeof sector, sizeof sector);
+    }
+  return sector;
+}
+
+/* Returns the sector that holds data sector number IDX of the
+   file whose on-disk inode is DISK_INODE, or 0 if it is a hole.
+   If CREATE is true, allocates the sector, and any index blocks
+   needed to reach it, if it does not exist, returning 0 only if
+   the disk is full; if this changes DISK_INODE itself, sets
+   *DIRTY to true if DIRTY is nonnull. */
+static disk_sector_t
+index_to_sector (struct inode_disk *disk_inode, size_t idx_,
+                 bool create, bool *dirty) 
+{
+  off_t idx = idx_;
+  disk_sector_t block;
+
+  if (idx < DIRECT_CNT)
+    return inode_slot (&disk_inode->direct[idx], create, dirty);
+  idx -= DIRECT_CNT;
+
+  if (idx < PTRS_PER_SECTOR)
+    {
+      block = inode_slot (&disk_inode->indirect, create, dirty);
+      return block != 0 ? block_slot (block, idx, create) : 0;
+    }
+  idx -= PTRS_PER_SECTOR;
+
+  ASSERT (idx < PTRS_PER_SECTOR * PTRS_PER_SECTOR);
+  block = inode_slot (&disk_inode->doubly_indirect, create, dirty);
+  if (block != 0)
+    block = block_slot (block, idx / PTRS_PER_SECTOR, create);
+  return block != 0 ? block_slot (block, idx % PTRS_PER_SECTOR, create) : 0;
+}
+
+/* Releases every sector listed in index block BLOCK, which lists
+   further index blocks if LEVEL is greater than 1, and then
+   BLOCK itself.  Slots are read from the cache one at a time,
+   rather than copying the whole block, to keep the kernel stack
+   small across the recursion. */
+static void
+deallocate_block (disk_sector_t block, int level) 
+{
+  off_t i;
+
+  for (i = 0; i < PTRS_PER_SECTOR; i++)
+    {
+      disk_sector_t sector = block_slot (block, i, false);
+      if (sector != 0)
+        {
+          if (level > 1)
+            deallocate_block (sector, level - 1);
+          else
+            free_map_release (sector, 1);
+        }
+    }
+  free_map_release (block, 1);
+}
+
+/* Releases all of the data and index sectors of DISK_INODE, but
+   not the sector that holds DISK_INODE itself. */
+static void
+deallocate (struct inode_disk *disk_inode) 
+{
+  size_t i;
+
+  for (i = 0; i < DIRECT_CNT; i++)
+    if (disk_inode->direct[i] != 0)
+      free_map_release (disk_inode->direct[i], 1);
+  if (disk_inode->indirect != 0)
+    deallocate_block (disk_inode->indirect, 1);
+  if (disk_inode->doubly_indirect != 0)
+    deallocate_block (disk_inode->doubly_indirect, 2);
+}
@@ -27,6 +27,7 @@ typedef unsigned long elem_type;
 struct bitmap
   {
     size_t bit_cnt;     /* Number of bits. */
+    size_t hint;        /* Where bitmap_scan_and_flip_next() starts. */
     elem_type *bits;    /* Elements that represent bits. */
   };
 
@@ -68,6 +69,65 @@ last_mask (const struct bitmap *b)
   int last_bits = b->bit_cnt % ELEM_BITS;
   return last_bits ? ((elem_type) 1 << last_bits) - 1 : (elem_type) -1;
 }
+
+/* Returns a mask with the bits for BIT_IDX and above within its
+   element turned on. */
+static inline elem_type
+high_mask (size_t bit_idx) 
+{
+  return (elem_type) -1 << (bit_idx % ELEM_BITS);
+}
+
+/* Returns the index of the least significant 1-bit in ELEM,
+   which must be nonzero. */
+static inline size_t
+first_one (elem_type elem) 
+{
+  elem_type idx;
+
+  ASSERT (elem != 0);
+  asm ("bsfl %1, %0" : "=r" (idx) : "rm" (elem) : "cc");
+  return idx;
+}
+
+/* Returns the number of 1-bits in ELEM. */
+static inline size_t
+count_ones (elem_type elem) 
+{
+  elem = elem - ((elem >> 1) & 0x55555555);
+  elem = (elem & 0x33333333) + ((elem >> 2) & 0x33333333);
+  elem = (elem + (elem >> 4)) & 0x0f0f0f0f;
+  return (elem * 0x01010101) >> 24;
+}
+
+/* Returns the index of the first bit in B at or after START and
+   before END that is set to VALUE, or END if there is none.
+
+   Works a whole element at a time: elements that have no bit set
+   to VALUE are skipped with a single comparison, and the first
+   matching bit in the remaining element is found with BSF. */
+static size_t
+find_first (const struct bitmap *b, size_t start, size_t end, bool value) 
+{
+  elem_type flip = value ? 0 : (elem_type) -1;
+  size_t idx;
+  elem_type elem;
+
+  if (start >= end)
+    return end;
+
+  idx = elem_idx (start);
+  elem = (b->bits[idx] ^ flip) & high_mask (start);
+  while (elem == 0)
+    {
+      if (++idx >= elem_cnt (end))
+        return end;
+      elem = b->bits[idx] ^ flip;
+    }
+
+  start = idx * ELEM_BITS + first_one (elem);
+  return start < end ? start : end;
+}
 
 /* Creation and destruction. */
 
@@ -82,6 +142,7 @@ bitmap_create (size_t bit_cnt)
   if (b != NULL)
     {
       b->bit_cnt = bit_cnt;
+      b->hint = 0;
       b->bits = malloc (byte_cnt (bit_cnt));
       if (b->bits != NULL || bit_cnt == 0)
         {
@@ -104,6 +165,7 @@ bitmap_create_in_buf (size_t bit_cnt, void *block, size_t block_size UNUSED)
   ASSERT (block_size >= bitmap_buf_size (bit_cnt));
 
   b->bit_cnt = bit_cnt;
+  b->hint = 0;
   b->bits = (elem_type *) (b + 1);
   bitmap_set_all (b, false);
   return b;
@@ -214,18 +276,24 @@ bitmap_set_all (struct bitmap *b, bool value)
   bitmap_set_multiple (b, 0, bitmap_size (b), value);
 }
 
-/* Sets the CNT bits starting at START in B to VALUE. */
+/* Sets the CNT bits starting at START in B to VALUE.
+   Whole elements are stored directly; the partial elements at
+   either end are updated atomically, as by bitmap_set(). */
 void
 bitmap_set_multiple (struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
-  size_t i;
+  size_t end = start + cnt;
   
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
-  for (i = 0; i < cnt; i++)
-    bitmap_set (b, start + i, value);
+  for (; start < end && start % ELEM_BITS != 0; start++)
+    bitmap_set (b, start, value);
+  for (; start + ELEM_BITS <= end; start += ELEM_BITS)
+    b->bits[elem_idx (start)] = value ? (elem_type) -1 : 0;
+  for (; start < end; start++)
+    bitmap_set (b, start, value);
 }
 
 /* Returns the number of bits in B between START and START + CNT,
@@ -233,17 +301,21 @@ bitmap_set_multiple (struct bitmap *b, size_t start, size_t cnt, bool value)
 size_t
 bitmap_count (const struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
-  size_t i, value_cnt;
+  size_t end = start + cnt;
+  size_t one_cnt;
 
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
-  value_cnt = 0;
-  for (i = 0; i < cnt; i++)
-    if (bitmap_test (b, start + i) == value)
-      value_cnt++;
-  return value_cnt;
+  one_cnt = 0;
+  for (; start < end && start % ELEM_BITS != 0; start++)
+    one_cnt += bitmap_test (b, start);
+  for (; start + ELEM_BITS <= end; start += ELEM_BITS)
+    one_cnt += count_ones (b->bits[elem_idx (start)]);
+  for (; start < end; start++)
+    one_cnt += bitmap_test (b, start);
+  return value ? one_cnt : cnt - one_cnt;
 }
 
 /* Returns true if any bits in B between START and START + CNT,
@@ -251,16 +323,11 @@ bitmap_count (const struct bitmap *b, size_t start, size_t cnt, bool value)
 bool
 bitmap_contains (const struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
-  size_t i;
-  
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
-  for (i = 0; i < cnt; i++)
-    if (bitmap_test (b, start + i) == value)
-      return true;
-  return false;
+  return find_first (b, start, start + cnt, value) < start + cnt;
 }
 
 /* Returns true if any bits in B between START and START + CNT,
@@ -289,6 +356,33 @@ bitmap_all (const struct bitmap *b, size_t start, size_t cnt)
 
 /* Finding set or unset bits. */
 
+/* Finds and returns the starting index of the first group of CNT
+   consecutive bits in B at or after START and before END that
+   are all set to VALUE.
+   If there is no such group, returns BITMAP_ERROR. */
+static size_t
+scan_range (const struct bitmap *b, size_t start, size_t end, size_t cnt,
+            bool value) 
+{
+  if (cnt == 0)
+    return start;
+  while (end - start >= cnt)
+    {
+      /* Skip to the next bit set to VALUE, then see how far the
+         run extends.  A run that is too short is skipped as a
+         whole, since no group can start inside it either. */
+      size_t stop;
+      start = find_first (b, start, end, value);
+      if (end - start < cnt)
+        break;
+      stop = find_first (b, start, start + cnt, !value);
+      if (stop == start + cnt)
+        return start;
+      start = stop;
+    }
+  return BITMAP_ERROR;
+}
+
 /* Finds and returns the starting index of the first group of CNT
    consecutive bits in B at or after START that are all set to
    VALUE.
@@ -299,15 +393,7 @@ bitmap_scan (const struct bitmap *b, size_t start, size_t cnt, bool value)
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
 
-  if (cnt <= b->bit_cnt) 
-    {
-      size_t last = b->bit_cnt - cnt;
-      size_t i;
-      for (i = start; i <= last; i++)
-        if (!bitmap_contains (b, i, cnt, !value))
-          return i; 
-    }
-  return BITMAP_ERROR;
+  return scan_range (b, start, b->bit_cnt, cnt, value);
 }
 
 /* Finds the first group of CNT consecutive bits in B at or after
@@ -325,6 +411,31 @@ bitmap_scan_and_flip (struct bitmap *b, size_t start, size_t cnt, bool value)
     bitmap_set_multiple (b, idx, cnt, !value);
   return idx;
 }
+
+/* Like bitmap_scan_and_flip(), but next-fit: the search starts
+   just past the group found by the previous call, wrapping
+   around to the beginning of B if nothing is found between there
+   and the end.  Repeated allocations thus walk forward through
+   B instead of rescanning the same crowded prefix every time. */
+size_t
+bitmap_scan_and_flip_next (struct bitmap *b, size_t cnt, bool value)
+{
+  size_t hint, idx;
+
+  ASSERT (b != NULL);
+
+  hint = b->hint <= b->bit_cnt ? b->hint : 0;
+  idx = scan_range (b, hint, b->bit_cnt, cnt, value);
+  if (idx == BITMAP_ERROR && hint > 0)
+    idx = scan_range (b, 0, hint + cnt - 1 < b->bit_cnt
+                            ? hint + cnt - 1 : b->bit_cnt, cnt, value);
+  if (idx != BITMAP_ERROR) 
+    {
+      bitmap_set_multiple (b, idx, cnt, !value);
+      b->hint = idx + cnt;
+    }
+  return idx;
+}
 
 /* File input and output. */
 
@@ -359,6 +470,24 @@ bitmap_write (const struct bitmap *b, struct file *file)
   off_t size = byte_cnt (b->bit_cnt);
   return file_write_at (file, b->bits, size, 0) == size;
 }
+
+/* Writes the part of B that is stored in bytes OFS through
+   OFS + SIZE - 1 of its file to FILE, leaving the rest of the
+   file alone.  The range is clipped to bitmap_file_size(B).
+   Returns true if successful, false otherwise. */
+bool
+bitmap_write_part (const struct bitmap *b, struct file *file,
+                   size_t ofs, size_t size)
+{
+  size_t file_size = byte_cnt (b->bit_cnt);
+
+  if (ofs >= file_size)
+    return true;
+  if (size > file_size - ofs)
+    size = file_size - ofs;
+  return (size_t) file_write_at (file, (const char *) b->bits + ofs,
+                                 size, ofs) == size;
+}
 #endif /* FILESYS */
 
 /* Debugging. */
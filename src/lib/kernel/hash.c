@@ -12,12 +12,18 @@
 #define list_elem_to_hash_elem(LIST_ELEM)                       \
         list_entry(LIST_ELEM, struct hash_elem, list_elem)
 
+/* Number of old buckets moved to the new array by each hash
+   table operation while a resize is in progress. */
+#define MIGRATE_BUCKETS 2
+
 static struct list *find_bucket (struct hash *, struct hash_elem *);
 static struct hash_elem *find_elem (struct hash *, struct list *,
                                     struct hash_elem *);
 static void insert_elem (struct hash *, struct list *, struct hash_elem *);
 static void remove_elem (struct hash *, struct hash_elem *);
 static void rehash (struct hash *);
+static void migrate (struct hash *, size_t bucket_cnt);
+static struct list *next_bucket (struct hash *, struct list *);
 
 /* Initializes hash table H to compute hash values using HASH and
    compare hash elements using LESS, given auxiliary data AUX. */
@@ -28,6 +34,9 @@ hash_init (struct hash *h,
   h->elem_cnt = 0;
   h->bucket_cnt = 4;
   h->buckets = malloc (sizeof *h->buckets * h->bucket_cnt);
+  h->old_bucket_cnt = 0;
+  h->old_buckets = NULL;
+  h->migrate_idx = 0;
   h->hash = hash;
   h->less = less;
   h->aux = aux;
@@ -53,22 +62,26 @@ hash_init (struct hash *h,
 void
 hash_clear (struct hash *h, hash_action_func *destructor) 
 {
+  struct list *bucket;
   size_t i;
 
-  for (i = 0; i < h->bucket_cnt; i++) 
-    {
-      struct list *bucket = &h->buckets[i];
+  if (destructor != NULL) 
+    for (bucket = h->buckets; bucket != NULL; bucket = next_bucket (h, bucket))
+      while (!list_empty (bucket)) 
+        {
+          struct list_elem *list_elem = list_pop_front (bucket);
+          struct hash_elem *hash_elem = list_elem_to_hash_elem (list_elem);
+          destructor (hash_elem, h->aux);
+        }
 
-      if (destructor != NULL) 
-        while (!list_empty (bucket)) 
-          {
-            struct list_elem *list_elem = list_pop_front (bucket);
-            struct hash_elem *hash_elem = list_elem_to_hash_elem (list_elem);
-            destructor (hash_elem, h->aux);
-          }
+  for (i = 0; i < h->bucket_cnt; i++) 
+    list_init (&h->buckets[i]);
 
-      list_init (bucket); 
-    }    
+  /* Abandon any migration in progress. */
+  free (h->old_buckets);
+  h->old_buckets = NULL;
+  h->old_bucket_cnt = 0;
+  h->migrate_idx = 0;
 
   h->elem_cnt = 0;
 }
@@ -88,6 +101,7 @@ hash_destroy (struct hash *h, hash_action_func *destructor)
 {
   if (destructor != NULL)
     hash_clear (h, destructor);
+  free (h->old_buckets);
   free (h->buckets);
 }
 
@@ -127,7 +141,11 @@ hash_replace (struct hash *h, struct hash_elem *new)
 }
 
 /* Finds and returns an element equal to E in hash table H, or a
-   null pointer if no equal element exists in the table. */
+   null pointer if no equal element exists in the table.
+
+   Unlike insertion and deletion, this does not carry a resize
+   forward, so it does not modify H: it does not invalidate
+   iterators, and concurrent lookups need only exclude writers. */
 struct hash_elem *
 hash_find (struct hash *h, struct hash_elem *e) 
 {
@@ -162,13 +180,12 @@ hash_delete (struct hash *h, struct hash_elem *e)
 void
 hash_apply (struct hash *h, hash_action_func *action) 
 {
-  size_t i;
+  struct list *bucket;
   
   ASSERT (action != NULL);
 
-  for (i = 0; i < h->bucket_cnt; i++) 
+  for (bucket = h->buckets; bucket != NULL; bucket = next_bucket (h, bucket)) 
     {
-      struct list *bucket = &h->buckets[i];
       struct list_elem *elem, *next;
 
       for (elem = list_begin (bucket); elem != list_end (bucket); elem = next) 
@@ -223,7 +240,8 @@ hash_next (struct hash_iterator *i)
   i->elem = list_elem_to_hash_elem (list_next (&i->elem->list_elem));
   while (i->elem == list_elem_to_hash_elem (list_end (i->bucket)))
     {
-      if (++i->bucket >= i->hash->buckets + i->hash->bucket_cnt)
+      i->bucket = next_bucket (i->hash, i->bucket);
+      if (i->bucket == NULL)
         {
           i->elem = NULL;
           break;
@@ -301,12 +319,41 @@ hash_int (int i)
   return hash_bytes (&i, sizeof i);
 }
 
-/* Returns the bucket in H that E belongs in. */
+/* Returns the bucket in H that E belongs in.  While H is being
+   resized, that is E's bucket in the old array if that bucket
+   has not been migrated yet, and its bucket in the new array
+   otherwise. */
 static struct list *
 find_bucket (struct hash *h, struct hash_elem *e) 
 {
-  size_t bucket_idx = h->hash (e, h->aux) & (h->bucket_cnt - 1);
-  return &h->buckets[bucket_idx];
+  unsigned hash = h->hash (e, h->aux);
+
+  if (h->old_buckets != NULL)
+    {
+      size_t old_idx = hash & (h->old_bucket_cnt - 1);
+      if (old_idx >= h->migrate_idx)
+        return &h->old_buckets[old_idx];
+    }
+  return &h->buckets[hash & (h->bucket_cnt - 1)];
+}
+
+/* Returns the bucket that follows BUCKET in H, for iteration,
+   or a null pointer if BUCKET is the last one.  The buckets of
+   the new array come first, followed by the old buckets that
+   have not yet been migrated. */
+static struct list *
+next_bucket (struct hash *h, struct list *bucket) 
+{
+  if (bucket >= h->buckets && bucket < h->buckets + h->bucket_cnt)
+    {
+      if (++bucket < h->buckets + h->bucket_cnt)
+        return bucket;
+      if (h->old_buckets == NULL || h->migrate_idx >= h->old_bucket_cnt)
+        return NULL;
+      return &h->old_buckets[h->migrate_idx];
+    }
+  else
+    return ++bucket < h->old_buckets + h->old_bucket_cnt ? bucket : NULL;
 }
 
 /* Searches BUCKET in H for a hash element equal to E.  Returns
@@ -341,38 +388,52 @@ is_power_of_2 (size_t x)
 
 /* Element per bucket ratios. */
 #define MIN_ELEMS_PER_BUCKET  1 /* Elems/bucket < 1: reduce # of buckets. */
-#define BEST_ELEMS_PER_BUCKET 2 /* Ideal elems/bucket. */
 #define MAX_ELEMS_PER_BUCKET  4 /* Elems/bucket > 4: increase # of buckets. */
 
 /* Changes the number of buckets in hash table H to match the
    ideal.  This function can fail because of an out-of-memory
    condition, but that'll just make hash accesses less efficient;
-   we can still continue. */
+   we can still continue.
+
+   The bucket count is doubled or halved only when the load
+   factor leaves the range MIN_ELEMS_PER_BUCKET to
+   MAX_ELEMS_PER_BUCKET, which leaves it near 2 afterward.  The
+   element count then has to change by about half before another
+   resize, which is far longer than migrate() needs to finish
+   this one.
+
+   Only the new bucket array is set up here.  The elements are
+   moved over a few buckets at a time by migrate(), starting
+   with this call.  A resize that is already in progress is
+   carried forward instead of starting another. */
 static void
 rehash (struct hash *h) 
 {
-  size_t old_bucket_cnt, new_bucket_cnt;
-  struct list *new_buckets, *old_buckets;
+  size_t new_bucket_cnt;
+  struct list *new_buckets;
   size_t i;
 
   ASSERT (h != NULL);
 
-  /* Save old bucket info for later use. */
-  old_buckets = h->buckets;
-  old_bucket_cnt = h->bucket_cnt;
+  if (h->old_buckets != NULL)
+    {
+      migrate (h, MIGRATE_BUCKETS);
+      return;
+    }
 
   /* Calculate the number of buckets to use now.
-     We want one bucket for about every BEST_ELEMS_PER_BUCKET.
      We must have at least four buckets, and the number of
      buckets must be a power of 2. */
-  new_bucket_cnt = h->elem_cnt / BEST_ELEMS_PER_BUCKET;
-  if (new_bucket_cnt < 4)
-    new_bucket_cnt = 4;
-  while (!is_power_of_2 (new_bucket_cnt))
-    new_bucket_cnt = turn_off_least_1bit (new_bucket_cnt);
+  new_bucket_cnt = h->bucket_cnt;
+  while (h->elem_cnt > new_bucket_cnt * MAX_ELEMS_PER_BUCKET)
+    new_bucket_cnt *= 2;
+  while (new_bucket_cnt > 4
+         && h->elem_cnt < new_bucket_cnt * MIN_ELEMS_PER_BUCKET)
+    new_bucket_cnt /= 2;
+  ASSERT (is_power_of_2 (new_bucket_cnt));
 
   /* Don't do anything if the bucket count wouldn't change. */
-  if (new_bucket_cnt == old_bucket_cnt)
+  if (new_bucket_cnt == h->bucket_cnt)
     return;
 
   /* Allocate new buckets and initialize them as empty. */
@@ -387,29 +448,44 @@ rehash (struct hash *h)
   for (i = 0; i < new_bucket_cnt; i++) 
     list_init (&new_buckets[i]);
 
-  /* Install new bucket info. */
+  /* Install new bucket info, keeping the old buckets around
+     until all of their elements have been moved. */
+  h->old_buckets = h->buckets;
+  h->old_bucket_cnt = h->bucket_cnt;
+  h->migrate_idx = 0;
   h->buckets = new_buckets;
   h->bucket_cnt = new_bucket_cnt;
 
-  /* Move each old element into the appropriate new bucket. */
-  for (i = 0; i < old_bucket_cnt; i++) 
+  migrate (h, MIGRATE_BUCKETS);
+}
+
+/* Moves the elements of up to BUCKET_CNT old buckets in H into
+   the appropriate new buckets.  Frees the old bucket array once
+   it is empty. */
+static void
+migrate (struct hash *h, size_t bucket_cnt) 
+{
+  ASSERT (h->old_buckets != NULL);
+
+  for (; bucket_cnt > 0 && h->migrate_idx < h->old_bucket_cnt; bucket_cnt--)
     {
-      struct list *old_bucket;
-      struct list_elem *elem, *next;
+      struct list *old_bucket = &h->old_buckets[h->migrate_idx++];
 
-      old_bucket = &old_buckets[i];
-      for (elem = list_begin (old_bucket);
-           elem != list_end (old_bucket); elem = next) 
+      while (!list_empty (old_bucket)) 
         {
-          struct list *new_bucket
-            = find_bucket (h, list_elem_to_hash_elem (elem));
-          next = list_next (elem);
-          list_remove (elem);
-          list_push_front (new_bucket, elem);
+          struct list_elem *elem = list_pop_front (old_bucket);
+          unsigned hash = h->hash (list_elem_to_hash_elem (elem), h->aux);
+          list_push_front (&h->buckets[hash & (h->bucket_cnt - 1)], elem);
         }
     }
 
-  free (old_buckets);
+  if (h->migrate_idx >= h->old_bucket_cnt) 
+    {
+      free (h->old_buckets);
+      h->old_buckets = NULL;
+      h->old_bucket_cnt = 0;
+      h->migrate_idx = 0;
+    }
 }
 
 /* Inserts E into BUCKET (in hash table H). */
@@ -18,7 +18,24 @@
    conversion from a struct hash_elem back to a structure object
    that contains it.  This is the same technique used in the
    linked list implementation.  Refer to lib/kernel/list.h for a
-   detailed explanation. */
+   detailed explanation.
+
+   The table is resized incrementally.  When the load factor
+   drifts too far from the ideal, a new bucket array is
+   allocated, but elements are not moved all at once: each later
+   insertion or deletion moves the contents of a few old buckets
+   into the new array, until the old array is empty and can be
+   freed.  Until then, an element is in the old array if its old
+   bucket has not yet been moved and in the new array otherwise.
+   No single operation ever moves more than a small, fixed number
+   of buckets.
+
+   Lookups never move anything, so they may run concurrently with
+   each other and with iteration, as long as nothing inserts or
+   deletes at the same time.
+
+   For tables with small fixed-size keys, see also the
+   open-addressed table in lib/kernel/ohash.h. */
 
 #include <stdbool.h>
 #include <stddef.h>
@@ -61,6 +78,9 @@ struct hash
     size_t elem_cnt;            /* Number of elements in table. */
     size_t bucket_cnt;          /* Number of buckets, a power of 2. */
     struct list *buckets;       /* Array of `bucket_cnt' lists. */
+    size_t old_bucket_cnt;      /* Number of buckets in `old_buckets'. */
+    struct list *old_buckets;   /* Buckets being migrated, or null. */
+    size_t migrate_idx;         /* Next old bucket to migrate. */
     hash_hash_func *hash;       /* Hash function. */
     hash_less_func *less;       /* Comparison function. */
     void *aux;                  /* Auxiliary data for `hash' and `less'. */
@@ -0,0 +1,249 @@
+#include "heap.h"
+#include "../debug.h"
+
+/* A pairing heap is a tree in which every node is at least as
+   great as its children.  Each node points to its leftmost child,
+   and the children of a node form a doubly linked list through
+   their `next' and `prev' members, except that the leftmost
+   child's `prev' points to the parent instead.  The root's `prev'
+   and `next' are null.
+
+   Two heaps are melded in constant time by making the lesser
+   root the leftmost child of the greater one.  Removing the root
+   melds its children in two passes, first in pairs from left to
+   right and then the resulting heaps from right to left, which
+   is what gives the logarithmic amortized bound.  See Fredman,
+   Sedgewick, Sleator and Tarjan, "The pairing heap: A new form
+   of self-adjusting heap", Algorithmica 1 (1986). */
+
+static bool ranks_above (const struct heap *,
+                         const struct heap_elem *, const struct heap_elem *);
+static struct heap_elem *meld (const struct heap *,
+                               struct heap_elem *, struct heap_elem *);
+static struct heap_elem *merge_pairs (const struct heap *,
+                                      struct heap_elem *first);
+static void detach (struct heap_elem *);
+static void insert (struct heap *, struct heap_elem *);
+
+/* Initializes H as an empty heap ordered by LESS, given
+   auxiliary data AUX. */
+void
+heap_init (struct heap *h, heap_less_func *less, void *aux)
+{
+  ASSERT (h != NULL);
+  ASSERT (less != NULL);
+
+  h->root = NULL;
+  h->size = 0;
+  h->next_seq = 0;
+  h->less = less;
+  h->aux = aux;
+}
+
+/* Inserts E into H. */
+void
+heap_push (struct heap *h, struct heap_elem *e)
+{
+  ASSERT (h != NULL);
+  ASSERT (e != NULL);
+
+  e->seq = h->next_seq++;
+  insert (h, e);
+  h->size++;
+}
+
+/* Removes and returns the greatest element of H, which must not
+   be empty.  Of several equal greatest elements, the one pushed
+   first is returned. */
+struct heap_elem *
+heap_pop (struct heap *h)
+{
+  struct heap_elem *top;
+
+  ASSERT (h != NULL);
+  ASSERT (!heap_empty (h));
+
+  top = h->root;
+  h->root = merge_pairs (h, top->child);
+  h->size--;
+  return top;
+}
+
+/* Removes E, which must be in H, from H. */
+void
+heap_remove (struct heap *h, struct heap_elem *e)
+{
+  ASSERT (h != NULL);
+  ASSERT (e != NULL);
+
+  if (e == h->root)
+    heap_pop (h);
+  else
+    {
+      detach (e);
+      h->root = meld (h, h->root, merge_pairs (h, e->child));
+      h->size--;
+    }
+}
+
+/* Restores the heap order of H after the value of E, which must
+   be in H, has become greater or stayed the same. */
+void
+heap_increase (struct heap *h, struct heap_elem *e)
+{
+  ASSERT (h != NULL);
+  ASSERT (e != NULL);
+
+  /* E is still at least as great as its children, so its whole
+     subtree can be cut out and melded back in at the root. */
+  if (e != h->root)
+    {
+      detach (e);
+      h->root = meld (h, h->root, e);
+    }
+}
+
+/* Restores the heap order of H after the value of E, which must
+   be in H, has changed in any way.  E keeps its place among
+   equal elements. */
+void
+heap_update (struct heap *h, struct heap_elem *e)
+{
+  ASSERT (h != NULL);
+  ASSERT (e != NULL);
+
+  heap_remove (h, e);
+  insert (h, e);
+  h->size++;
+}
+
+/* Returns the greatest element of H, or a null pointer if H is
+   empty. */
+struct heap_elem *
+heap_top (const struct heap *h)
+{
+  ASSERT (h != NULL);
+
+  return h->root;
+}
+
+/* Returns the number of elements in H. */
+size_t
+heap_size (const struct heap *h)
+{
+  ASSERT (h != NULL);
+
+  return h->size;
+}
+
+/* Returns true if H is empty, false otherwise. */
+bool
+heap_empty (const struct heap *h)
+{
+  ASSERT (h != NULL);
+
+  return h->root == NULL;
+}
+
+/* Returns true if A belongs above B in H: if A is greater than
+   B, or if they are equal and A was pushed first. */
+static bool
+ranks_above (const struct heap *h,
+             const struct heap_elem *a, const struct heap_elem *b)
+{
+  if (h->less (b, a, h->aux))
+    return true;
+  else if (h->less (a, b, h->aux))
+    return false;
+  else
+    return (int) (a->seq - b->seq) < 0;
+}
+
+/* Melds the heaps rooted at A and B, either of which may be
+   null, and returns the new root.  A and B must not have
+   siblings or parents. */
+static struct heap_elem *
+meld (const struct heap *h, struct heap_elem *a, struct heap_elem *b)
+{
+  struct heap_elem *t;
+
+  if (a == NULL)
+    return b;
+  if (b == NULL)
+    return a;
+
+  if (ranks_above (h, b, a))
+    {
+      t = a;
+      a = b;
+      b = t;
+    }
+
+  b->prev = a;
+  b->next = a->child;
+  if (a->child != NULL)
+    a->child->prev = b;
+  a->child = b;
+  return a;
+}
+
+/* Melds the sibling list that starts at FIRST into a single heap
+   and returns its root, or a null pointer if FIRST is null. */
+static struct heap_elem *
+merge_pairs (const struct heap *h, struct heap_elem *first)
+{
+  struct heap_elem *stack = NULL;
+  struct heap_elem *root = NULL;
+
+  /* First pass: meld adjacent pairs from left to right, stacking
+     the results through their `prev' members. */
+  while (first != NULL)
+    {
+      struct heap_elem *a = first;
+      struct heap_elem *b = a->next;
+
+      first = b != NULL ? b->next : NULL;
+      a->next = a->prev = NULL;
+      if (b != NULL)
+        b->next = b->prev = NULL;
+
+      a = meld (h, a, b);
+      a->prev = stack;
+      stack = a;
+    }
+
+  /* Second pass: meld the stacked heaps from right to left. */
+  while (stack != NULL)
+    {
+      struct heap_elem *next = stack->prev;
+
+      stack->prev = NULL;
+      root = meld (h, stack, root);
+      stack = next;
+    }
+
+  return root;
+}
+
+/* Cuts E, which must not be a root, and its subtree out of its
+   parent's list of children. */
+static void
+detach (struct heap_elem *e)
+{
+  if (e->prev->child == e)
+    e->prev->child = e->next;
+  else
+    e->prev->next = e->next;
+  if (e->next != NULL)
+    e->next->prev = e->prev;
+  e->next = e->prev = NULL;
+}
+
+/* Inserts E into H without assigning it a new sequence number or
+   counting it in H's size. */
+static void
+insert (struct heap *h, struct heap_elem *e)
+{
+  e->child = e->next = e->prev = NULL;
+  h->root = meld (h, h->root, e);
+}
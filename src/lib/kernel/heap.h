@@ -0,0 +1,84 @@
+#ifndef __LIB_KERNEL_HEAP_H
+#define __LIB_KERNEL_HEAP_H
+
+/* Priority queue (pairing heap).
+
+   Like the linked list in list.h, this heap does not use dynamic
+   allocation.  Each structure that can be in a heap must embed a
+   struct heap_elem member, and the heap_entry macro converts a
+   struct heap_elem back to the structure that contains it, just
+   as list_entry does.
+
+   The heap keeps its greatest element, according to the
+   heap_less_func given to heap_init(), at the top.  Elements
+   that compare equal come out in the order they were pushed, so
+   a heap of threads keyed by priority behaves like a FIFO queue
+   within each priority.
+
+   Cost of each operation, where N is the number of elements:
+
+     - heap_push(), heap_top(), heap_increase(): O(1).
+
+     - heap_pop(), heap_remove(), heap_update(): O(log N)
+       amortized.
+
+   If the value that an element is ordered by changes while it is
+   in a heap, the heap must be told with heap_increase() (if the
+   element can only have grown) or heap_update() (otherwise)
+   before any other operation on the heap. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Heap element. */
+struct heap_elem
+  {
+    struct heap_elem *child;    /* Leftmost child. */
+    struct heap_elem *next;     /* Right sibling. */
+    struct heap_elem *prev;     /* Left sibling, or parent if leftmost. */
+    unsigned seq;               /* Push order, for breaking ties. */
+  };
+
+/* Compares the value of two heap elements A and B, given
+   auxiliary data AUX.  Returns true if A is less than B, or
+   false if A is greater than or equal to B. */
+typedef bool heap_less_func (const struct heap_elem *a,
+                             const struct heap_elem *b,
+                             void *aux);
+
+/* Heap. */
+struct heap
+  {
+    struct heap_elem *root;     /* Greatest element, or null. */
+    size_t size;                /* Number of elements. */
+    unsigned next_seq;          /* Sequence number for next push. */
+    heap_less_func *less;       /* Comparison function. */
+    void *aux;                  /* Auxiliary data for `less'. */
+  };
+
+/* Converts pointer to heap element HEAP_ELEM into a pointer to
+   the structure that HEAP_ELEM is embedded inside.  Supply the
+   name of the outer structure STRUCT and the member name MEMBER
+   of the heap element. */
+#define heap_entry(HEAP_ELEM, STRUCT, MEMBER)           \
+        ((STRUCT *) ((uint8_t *) &(HEAP_ELEM)->child    \
+                     - offsetof (STRUCT, MEMBER.child)))
+
+void heap_init (struct heap *, heap_less_func *, void *aux);
+
+/* Insertion and removal. */
+void heap_push (struct heap *, struct heap_elem *);
+struct heap_elem *heap_pop (struct heap *);
+void heap_remove (struct heap *, struct heap_elem *);
+
+/* Changing an element's value. */
+void heap_increase (struct heap *, struct heap_elem *);
+void heap_update (struct heap *, struct heap_elem *);
+
+/* Heap properties. */
+struct heap_elem *heap_top (const struct heap *);
+size_t heap_size (const struct heap *);
+bool heap_empty (const struct heap *);
+
+#endif /* lib/kernel/heap.h */
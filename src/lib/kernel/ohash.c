@@ -0,0 +1,201 @@
+/* Open-addressed hash table.
+
+   See ohash.h for basic information. */
+
+#include "ohash.h"
+#include "../debug.h"
+#include "threads/malloc.h"
+
+/* Smallest number of slots in a table. */
+#define MIN_SLOTS 8
+
+static size_t home_slot (const struct ohash *, uintptr_t key);
+static struct ohash_slot *find_slot (const struct ohash *, uintptr_t key);
+static bool resize (struct ohash *, size_t slot_cnt);
+
+/* Initializes hash table H as empty.  Returns true if
+   successful, false if memory allocation failed. */
+bool
+ohash_init (struct ohash *h)
+{
+  h->elem_cnt = 0;
+  h->slot_cnt = MIN_SLOTS;
+  h->slots = malloc (sizeof *h->slots * h->slot_cnt);
+  if (h->slots == NULL)
+    return false;
+
+  ohash_clear (h);
+  return true;
+}
+
+/* Removes all the elements from H. */
+void
+ohash_clear (struct ohash *h)
+{
+  size_t i;
+
+  for (i = 0; i < h->slot_cnt; i++)
+    h->slots[i].value = NULL;
+  h->elem_cnt = 0;
+}
+
+/* Destroys hash table H.  If the values in H are dynamically
+   allocated, it is the caller's responsibility to deallocate
+   them first, e.g. with ohash_apply(). */
+void
+ohash_destroy (struct ohash *h)
+{
+  free (h->slots);
+}
+
+/* Returns the value stored under KEY in H, or a null pointer if
+   KEY is not in H. */
+void *
+ohash_find (const struct ohash *h, uintptr_t key)
+{
+  return find_slot (h, key)->value;
+}
+
+/* Stores VALUE, which must not be a null pointer, under KEY in
+   H.  Returns true if successful, false if KEY was already in H
+   or if H was full and could not be grown. */
+bool
+ohash_insert (struct ohash *h, uintptr_t key, void *value)
+{
+  struct ohash_slot *slot;
+
+  ASSERT (value != NULL);
+
+  /* Grow at 3/4 full.  If that fails, keep going as long as at
+     least one slot stays empty to end each probe sequence. */
+  if ((h->elem_cnt + 1) * 4 > h->slot_cnt * 3
+      && !resize (h, h->slot_cnt * 2)
+      && h->elem_cnt + 1 >= h->slot_cnt)
+    return false;
+
+  slot = find_slot (h, key);
+  if (slot->value != NULL)
+    return false;
+
+  slot->key = key;
+  slot->value = value;
+  h->elem_cnt++;
+  return true;
+}
+
+/* Removes KEY from H and returns the value that was stored under
+   it, or a null pointer if KEY was not in H. */
+void *
+ohash_delete (struct ohash *h, uintptr_t key)
+{
+  size_t mask = h->slot_cnt - 1;
+  struct ohash_slot *slot = find_slot (h, key);
+  void *value = slot->value;
+  size_t hole, i;
+
+  if (value == NULL)
+    return NULL;
+
+  /* Close the hole by moving back each later element of the
+     probe sequence whose home slot is not between the hole and
+     the element's current slot (cyclically). */
+  hole = slot - h->slots;
+  for (i = (hole + 1) & mask; h->slots[i].value != NULL; i = (i + 1) & mask)
+    {
+      size_t home = home_slot (h, h->slots[i].key);
+      if (((i - home) & mask) >= ((i - hole) & mask))
+        {
+          h->slots[hole] = h->slots[i];
+          hole = i;
+        }
+    }
+  h->slots[hole].value = NULL;
+  h->elem_cnt--;
+
+  /* Shrink below 1/8 full.  Failure is harmless. */
+  if (h->slot_cnt > MIN_SLOTS && h->elem_cnt * 8 < h->slot_cnt)
+    resize (h, h->slot_cnt / 2);
+
+  return value;
+}
+
+/* Calls ACTION for each element in H in arbitrary order, passing
+   AUX along.  Modifying H while ohash_apply() is running yields
+   undefined behavior. */
+void
+ohash_apply (struct ohash *h, ohash_action_func *action, void *aux)
+{
+  size_t i;
+
+  ASSERT (action != NULL);
+
+  for (i = 0; i < h->slot_cnt; i++)
+    if (h->slots[i].value != NULL)
+      action (h->slots[i].key, h->slots[i].value, aux);
+}
+
+/* Returns the number of elements in H. */
+size_t
+ohash_size (const struct ohash *h)
+{
+  return h->elem_cnt;
+}
+
+/* Returns the slot where the probe sequence for KEY in H begins.
+   The key is mixed first so that keys differing only in their
+   high bits, such as page addresses, spread across the table. */
+static size_t
+home_slot (const struct ohash *h, uintptr_t key)
+{
+  uint32_t x = key;
+
+  x ^= x >> 16;
+  x *= 0x45d9f3b;
+  x ^= x >> 16;
+  return x & (h->slot_cnt - 1);
+}
+
+/* Returns the slot in H that holds KEY, or if KEY is not in H,
+   the empty slot where it would be inserted. */
+static struct ohash_slot *
+find_slot (const struct ohash *h, uintptr_t key)
+{
+  size_t mask = h->slot_cnt - 1;
+  size_t i;
+
+  for (i = home_slot (h, key); h->slots[i].value != NULL; i = (i + 1) & mask)
+    if (h->slots[i].key == key)
+      break;
+  return &h->slots[i];
+}
+
+/* Changes the number of slots in H to SLOT_CNT, a power of 2
+   greater than H's element count, and reinserts every element.
+   Returns true if successful, false if memory allocation
+   failed, in which case H is unchanged. */
+static bool
+resize (struct ohash *h, size_t slot_cnt)
+{
+  struct ohash_slot *old_slots = h->slots;
+  size_t old_slot_cnt = h->slot_cnt;
+  size_t i;
+
+  ASSERT (slot_cnt > h->elem_cnt);
+
+  h->slots = malloc (sizeof *h->slots * slot_cnt);
+  if (h->slots == NULL)
+    {
+      h->slots = old_slots;
+      return false;
+    }
+  h->slot_cnt = slot_cnt;
+  for (i = 0; i < slot_cnt; i++)
+    h->slots[i].value = NULL;
+
+  for (i = 0; i < old_slot_cnt; i++)
+    if (old_slots[i].value != NULL)
+      *find_slot (h, old_slots[i].key) = old_slots[i];
+
+  free (old_slots);
+  return true;
+}
@@ -0,0 +1,61 @@
+#ifndef __LIB_KERNEL_OHASH_H
+#define __LIB_KERNEL_OHASH_H
+
+/* Open-addressed hash table.
+
+   An alternative to the chained hash table in hash.h for maps
+   from a small integer key, such as a page address or a sector
+   number, to a pointer.  Keys and values are stored inline in a
+   single array of slots, so a lookup usually touches one cache
+   line instead of following a chain of list elements through
+   memory, and the objects being mapped need not embed any
+   member of their own.
+
+   Collisions are resolved by linear probing.  Deletion shifts
+   later members of the probe sequence backward, so there are no
+   tombstones and lookups never slow down as the table ages.
+
+   A null pointer marks an empty slot, so null values may not be
+   stored.  The table doubles in size when it becomes 3/4 full
+   and halves when it drops below 1/8 full. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* A slot in an open-addressed hash table. */
+struct ohash_slot
+  {
+    uintptr_t key;              /* Key. */
+    void *value;                /* Value, or null if slot is empty. */
+  };
+
+/* Open-addressed hash table. */
+struct ohash
+  {
+    size_t elem_cnt;            /* Number of elements in table. */
+    size_t slot_cnt;            /* Number of slots, a power of 2. */
+    struct ohash_slot *slots;   /* Array of `slot_cnt' slots. */
+  };
+
+/* Performs some operation on the element with KEY and VALUE,
+   given auxiliary data AUX. */
+typedef void ohash_action_func (uintptr_t key, void *value, void *aux);
+
+/* Basic life cycle. */
+bool ohash_init (struct ohash *);
+void ohash_clear (struct ohash *);
+void ohash_destroy (struct ohash *);
+
+/* Search, insertion, deletion. */
+void *ohash_find (const struct ohash *, uintptr_t key);
+bool ohash_insert (struct ohash *, uintptr_t key, void *value);
+void *ohash_delete (struct ohash *, uintptr_t key);
+
+/* Iteration. */
+void ohash_apply (struct ohash *, ohash_action_func *, void *aux);
+
+/* Information. */
+size_t ohash_size (const struct ohash *);
+
+#endif /* lib/kernel/ohash.h */
@@ -0,0 +1,96 @@
+#ifndef __LIB_KERNEL_RBTREE_H
+#define __LIB_KERNEL_RBTREE_H
+
+/* Ordered set (red-black tree).
+
+   Like the linked list in list.h, this tree does not use dynamic
+   allocation.  Each structure that can be in a tree must embed a
+   struct rb_elem member, and the rb_entry macro converts a
+   struct rb_elem back to the structure that contains it, just as
+   list_entry does.
+
+   Elements are kept in ascending order according to the
+   rb_less_func given to rb_init().  Equal elements are allowed
+   and keep the order in which they were inserted, as with
+   list_insert_ordered().  Iteration runs from rb_min() through
+   rb_next() until it returns a null pointer:
+
+      struct rb_elem *e;
+
+      for (e = rb_min (&tree); e != NULL; e = rb_next (e))
+        {
+          struct foo *f = rb_entry (e, struct foo, elem);
+          ...do something with f...
+        }
+
+   Cost of each operation, where N is the number of elements:
+
+     - rb_insert(), rb_remove(), rb_find(), rb_lower_bound(),
+       rb_min(), rb_max(): O(log N).
+
+     - rb_next(), rb_prev(): O(log N), but O(1) amortized over a
+       complete iteration.
+
+   An element's value must not change while it is in a tree.  To
+   reorder an element, remove it, change it, and insert it
+   again. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Red-black tree element. */
+struct rb_elem
+  {
+    struct rb_elem *parent;     /* Parent, or null for the root. */
+    struct rb_elem *left;       /* Lesser subtree. */
+    struct rb_elem *right;      /* Greater-or-equal subtree. */
+    bool red;                   /* Red or black? */
+  };
+
+/* Compares the value of two tree elements A and B, given
+   auxiliary data AUX.  Returns true if A is less than B, or
+   false if A is greater than or equal to B. */
+typedef bool rb_less_func (const struct rb_elem *a,
+                           const struct rb_elem *b,
+                           void *aux);
+
+/* Red-black tree. */
+struct rbtree
+  {
+    struct rb_elem *root;       /* Root, or null if empty. */
+    size_t size;                /* Number of elements. */
+    rb_less_func *less;         /* Comparison function. */
+    void *aux;                  /* Auxiliary data for `less'. */
+  };
+
+/* Converts pointer to tree element RB_ELEM into a pointer to
+   the structure that RB_ELEM is embedded inside.  Supply the
+   name of the outer structure STRUCT and the member name MEMBER
+   of the tree element. */
+#define rb_entry(RB_ELEM, STRUCT, MEMBER)               \
+        ((STRUCT *) ((uint8_t *) &(RB_ELEM)->parent     \
+                     - offsetof (STRUCT, MEMBER.parent)))
+
+void rb_init (struct rbtree *, rb_less_func *, void *aux);
+
+/* Insertion and removal. */
+void rb_insert (struct rbtree *, struct rb_elem *);
+void rb_remove (struct rbtree *, struct rb_elem *);
+
+/* Search. */
+struct rb_elem *rb_find (const struct rbtree *, const struct rb_elem *);
+struct rb_elem *rb_lower_bound (const struct rbtree *,
+                                const struct rb_elem *);
+
+/* Traversal. */
+struct rb_elem *rb_min (const struct rbtree *);
+struct rb_elem *rb_max (const struct rbtree *);
+struct rb_elem *rb_next (const struct rb_elem *);
+struct rb_elem *rb_prev (const struct rb_elem *);
+
+/* Tree properties. */
+size_t rb_size (const struct rbtree *);
+bool rb_empty (const struct rbtree *);
+
+#endif /* lib/kernel/rbtree.h */
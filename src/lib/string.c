@@ -1,5 +1,93 @@
 #include <string.h>
 #include <debug.h>
+#include <stdint.h>
+
+/* The memory and string primitives below work a 32-bit word at
+   a time wherever they can.  Copies and fills use the x86 string
+   instructions: `rep movsb' or `rep stosb' to bring the
+   destination to a word boundary, `rep movsl' or `rep stosl' for
+   the aligned bulk, and `rep movsb' or `rep stosb' again for the
+   tail.  Searches and comparisons load whole words and fall back
+   to bytes only to locate the exact byte of interest.  Blocks
+   shorter than SMALL_SIZE bytes are not worth the setup and are
+   handled a byte at a time.
+
+   Word loads in strlen() go past the end of the string, but only
+   within the aligned word that holds the terminator, which never
+   crosses a page boundary. */
+
+/* Size below which we do not bother with word operations. */
+#define SMALL_SIZE 16
+
+/* A word that may alias any other type. */
+typedef uint32_t word_t __attribute__ ((may_alias));
+
+/* Each byte of a word set to 0x01, or to 0x80. */
+#define ONES 0x01010101u
+#define HIGHS 0x80808080u
+
+/* Nonzero if some byte of word W is zero.  See "Determine if a
+   word has a zero byte" in Sean Anderson's "Bit Twiddling
+   Hacks". */
+#define HAS_ZERO(W) (((W) - ONES) & ~(W) & HIGHS)
+
+/* Copies SIZE bytes forward from SRC to DST with the string
+   instructions. */
+static inline void
+copy_forward (unsigned char *dst, const unsigned char *src, size_t size) 
+{
+  if (size >= SMALL_SIZE) 
+    {
+      size_t head = -(uintptr_t) dst & 3;
+      size_t words;
+
+      size -= head;
+      words = size / 4;
+      size %= 4;
+      asm volatile ("rep movsb"
+                    : "+D" (dst), "+S" (src), "+c" (head) : : "memory");
+      asm volatile ("rep movsl"
+                    : "+D" (dst), "+S" (src), "+c" (words) : : "memory");
+    }
+  asm volatile ("rep movsb"
+                : "+D" (dst), "+S" (src), "+c" (size) : : "memory");
+}
+
+/* Copies SIZE bytes backward, from the end toward the start, from
+   SRC to DST with the string instructions.  DST_END and SRC_END
+   point just past the last byte of each block.  The direction
+   flag must be clear again before any other code runs, so this
+   is done in a single asm statement. */
+static inline void
+copy_backward (unsigned char *dst_end, const unsigned char *src_end,
+               size_t size) 
+{
+  unsigned char *dst = dst_end - 1;
+  const unsigned char *src = src_end - 1;
+  size_t tail = 0, words = 0;
+
+  if (size >= SMALL_SIZE) 
+    {
+      tail = (uintptr_t) dst_end & 3;
+      size -= tail;
+      words = size / 4;
+      size %= 4;
+    }
+  asm volatile ("std\n\t"
+                "rep movsb\n\t"
+                "subl $3, %%edi\n\t"
+                "subl $3, %%esi\n\t"
+                "movl %3, %%ecx\n\t"
+                "rep movsl\n\t"
+                "addl $3, %%edi\n\t"
+                "addl $3, %%esi\n\t"
+                "movl %4, %%ecx\n\t"
+                "rep movsb\n\t"
+                "cld"
+                : "+D" (dst), "+S" (src), "+c" (tail)
+                : "r" (words), "r" (size)
+                : "memory");
+}
 
 /* Copies SIZE bytes from SRC to DST, which must not overlap.
    Returns DST. */
@@ -12,8 +100,7 @@ memcpy (void *dst_, const void *src_, size_t size)
   ASSERT (dst != NULL || size == 0);
   ASSERT (src != NULL || size == 0);
 
-  while (size-- > 0)
-    *dst++ = *src++;
+  copy_forward (dst, src, size);
 
   return dst_;
 }
@@ -29,20 +116,12 @@ memmove (void *dst_, const void *src_, size_t size)
   ASSERT (dst != NULL || size == 0);
   ASSERT (src != NULL || size == 0);
 
-  if (dst < src) 
-    {
-      while (size-- > 0)
-        *dst++ = *src++;
-    }
-  else 
-    {
-      dst += size;
-      src += size;
-      while (size-- > 0)
-        *--dst = *--src;
-    }
+  if (dst <= src || dst >= src + size)
+    copy_forward (dst, src, size);
+  else
+    copy_backward (dst + size, src + size, size);
 
-  return dst;
+  return dst_;
 }
 
 /* Find the first differing byte in the two blocks of SIZE bytes
@@ -58,6 +137,12 @@ memcmp (const void *a_, const void *b_, size_t size)
   ASSERT (a != NULL || size == 0);
   ASSERT (b != NULL || size == 0);
 
+  /* Skip over equal words.  The first differing byte is then in
+     the word where we stopped, or beyond it. */
+  for (; size >= 4; a += 4, b += 4, size -= 4)
+    if (*(const word_t *) a != *(const word_t *) b)
+      break;
+
   for (; size-- > 0; a++, b++)
     if (*a != *b)
       return *a > *b ? +1 : -1;
@@ -95,9 +180,23 @@ memchr (const void *block_, int ch_, size_t size)
 {
   const unsigned char *block = block_;
   unsigned char ch = ch_;
+  uint32_t pattern = ch * ONES;
 
   ASSERT (block != NULL || size == 0);
 
+  /* Bytes up to a word boundary. */
+  for (; size > 0 && (uintptr_t) block % 4 != 0; size--, block++)
+    if (*block == ch)
+      return (void *) block;
+
+  /* Whole words: a byte equal to CH is a zero byte in W. */
+  for (; size >= 4; size -= 4, block += 4)
+    {
+      uint32_t w = *(const word_t *) block ^ pattern;
+      if (HAS_ZERO (w))
+        break;
+    }
+
   for (; size-- > 0; block++)
     if (*block == ch)
       return (void *) block;
@@ -279,11 +378,26 @@ void *
 memset (void *dst_, int value, size_t size) 
 {
   unsigned char *dst = dst_;
+  unsigned char byte = value;
 
   ASSERT (dst != NULL || size == 0);
-  
-  while (size-- > 0)
-    *dst++ = value;
+
+  if (size >= SMALL_SIZE) 
+    {
+      size_t head = -(uintptr_t) dst & 3;
+      size_t words;
+
+      size -= head;
+      words = size / 4;
+      size %= 4;
+      asm volatile ("rep stosb"
+                    : "+D" (dst), "+c" (head) : "a" (byte) : "memory");
+      asm volatile ("rep stosl"
+                    : "+D" (dst), "+c" (words) : "a" (byte * ONES)
+                    : "memory");
+    }
+  asm volatile ("rep stosb"
+                : "+D" (dst), "+c" (size) : "a" (byte) : "memory");
 
   return dst_;
 }
@@ -293,10 +407,20 @@ size_t
 strlen (const char *string) 
 {
   const char *p;
+  const word_t *w;
 
   ASSERT (string != NULL);
 
-  for (p = string; *p != '\0'; p++)
+  /* Bytes up to a word boundary. */
+  for (p = string; (uintptr_t) p % 4 != 0; p++)
+    if (*p == '\0')
+      return p - string;
+
+  /* Whole words, until one contains the terminator. */
+  for (w = (const word_t *) p; !HAS_ZERO (*w); w++)
+    continue;
+
+  for (p = (const char *) w; *p != '\0'; p++)
     continue;
   return p - string;
 }
@@ -0,0 +1,226 @@
+/* Test program and benchmark for lib/kernel/heap.c.
+
+   Pushes, pops, removes, and reprioritizes random values,
+   checking the results against a simple array, then compares the
+   cost of a priority queue built on the pairing heap against one
+   built with list_insert_ordered().
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <debug.h>
+#include <heap.h>
+#include <list.h>
+#include <random.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "threads/test.h"
+
+/* Maximum number of elements in a heap that we will test. */
+#define MAX_SIZE 256
+
+/* Number of elements for the benchmark. */
+#define BENCH_SIZE 2048
+
+/* A heap element. */
+struct value
+  {
+    struct heap_elem heap_elem; /* Heap element. */
+    struct list_elem elem;      /* List element, for the benchmark. */
+    int value;                  /* Item value. */
+    int seq;                    /* Push order. */
+    bool in_heap;               /* In the heap now? */
+  };
+
+static struct value values[BENCH_SIZE];
+
+static bool value_less (const struct heap_elem *, const struct heap_elem *,
+                        void *);
+static bool value_list_less (const struct list_elem *,
+                             const struct list_elem *, void *);
+static struct value *expected_top (int size);
+static void benchmark (size_t size);
+
+/* Test the pairing heap implementation. */
+void
+test (void)
+{
+  int size;
+
+  printf ("testing various size heaps:");
+  for (size = 1; size <= MAX_SIZE; size *= 2)
+    {
+      struct heap heap;
+      size_t cnt = 0;
+      int seq = 0;
+      int i;
+
+      printf (" %d", size);
+      heap_init (&heap, value_less, NULL);
+      for (i = 0; i < size; i++)
+        values[i].in_heap = false;
+
+      for (i = 0; i < size * 20; i++)
+        {
+          struct value *v = &values[random_ulong () % size];
+          struct value *top;
+
+          switch (random_ulong () % 4)
+            {
+            case 0:
+            case 1:
+              /* Push.  Values repeat, so that the FIFO order of
+                 equal elements gets tested. */
+              if (!v->in_heap)
+                {
+                  v->value = random_ulong () % (size / 2 + 1);
+                  v->seq = seq++;
+                  v->in_heap = true;
+                  heap_push (&heap, &v->heap_elem);
+                  cnt++;
+                }
+              break;
+
+            case 2:
+              /* Pop or remove. */
+              if (random_ulong () % 2 && !heap_empty (&heap))
+                v = heap_entry (heap_pop (&heap), struct value, heap_elem);
+              else if (v->in_heap)
+                heap_remove (&heap, &v->heap_elem);
+              else
+                break;
+              v->in_heap = false;
+              cnt--;
+              break;
+
+            case 3:
+              /* Change a value.  Either way, V keeps its original
+                 place among equal elements. */
+              if (v->in_heap)
+                {
+                  int old = v->value;
+                  v->value = random_ulong () % (size / 2 + 1);
+                  if (v->value >= old && random_ulong () % 2)
+                    heap_increase (&heap, &v->heap_elem);
+                  else
+                    heap_update (&heap, &v->heap_elem);
+                }
+              break;
+            }
+
+          ASSERT (heap_size (&heap) == cnt);
+          ASSERT (heap_empty (&heap) == (cnt == 0));
+          top = expected_top (size);
+          ASSERT (heap_top (&heap) == (top != NULL ? &top->heap_elem : NULL));
+        }
+
+      /* Drain the heap and check that it comes out in order. */
+      while (!heap_empty (&heap))
+        {
+          struct value *v = heap_entry (heap_pop (&heap), struct value,
+                                        heap_elem);
+          struct value *top;
+
+          v->in_heap = false;
+          top = expected_top (size);
+          ASSERT (top == NULL || top->value <= v->value);
+        }
+    }
+  printf (" done\n");
+
+  benchmark (BENCH_SIZE / 8);
+  benchmark (BENCH_SIZE);
+  printf ("heap: PASS\n");
+}
+
+/* Returns the element with the greatest value among the first
+   SIZE VALUES that are in the heap, preferring the one pushed
+   first among equals, or a null pointer if none are in the
+   heap. */
+static struct value *
+expected_top (int size)
+{
+  struct value *top = NULL;
+  int i;
+
+  for (i = 0; i < size; i++)
+    {
+      struct value *v = &values[i];
+      if (v->in_heap
+          && (top == NULL || v->value > top->value
+              || (v->value == top->value && v->seq < top->seq)))
+        top = v;
+    }
+  return top;
+}
+
+/* Returns true if value A is less than value B, false
+   otherwise. */
+static bool
+value_less (const struct heap_elem *a_, const struct heap_elem *b_,
+            void *aux UNUSED)
+{
+  const struct value *a = heap_entry (a_, struct value, heap_elem);
+  const struct value *b = heap_entry (b_, struct value, heap_elem);
+
+  return a->value < b->value;
+}
+
+/* Returns true if value A is greater than value B, false
+   otherwise, so that list_insert_ordered() keeps the greatest
+   value at the front as the heap does. */
+static bool
+value_list_less (const struct list_elem *a_, const struct list_elem *b_,
+                 void *aux UNUSED)
+{
+  const struct value *a = list_entry (a_, struct value, elem);
+  const struct value *b = list_entry (b_, struct value, elem);
+
+  return a->value > b->value;
+}
+
+/* Returns the CPU's time-stamp counter. */
+static inline uint64_t
+rdtsc (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* Prints the cycles taken to push SIZE random values into a
+   priority queue and pop them all back out, with the heap and
+   with an ordered list. */
+static void
+benchmark (size_t size)
+{
+  struct heap heap;
+  struct list list;
+  uint64_t start, heap_cycles, list_cycles;
+  size_t i;
+
+  ASSERT (size <= BENCH_SIZE);
+  for (i = 0; i < size; i++)
+    values[i].value = random_ulong () % 64;
+
+  start = rdtsc ();
+  heap_init (&heap, value_less, NULL);
+  for (i = 0; i < size; i++)
+    heap_push (&heap, &values[i].heap_elem);
+  while (!heap_empty (&heap))
+    heap_pop (&heap);
+  heap_cycles = rdtsc () - start;
+
+  start = rdtsc ();
+  list_init (&list);
+  for (i = 0; i < size; i++)
+    list_insert_ordered (&list, &values[i].elem, value_list_less, NULL);
+  while (!list_empty (&list))
+    list_pop_front (&list);
+  list_cycles = rdtsc () - start;
+
+  printf ("heap: %zu elements: %llu cycles/element (list: %llu)\n",
+          size, heap_cycles / size, list_cycles / size);
+}
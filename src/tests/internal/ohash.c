@@ -0,0 +1,188 @@
+/* Test program and benchmark for lib/kernel/ohash.c.
+
+   Inserts, finds, and deletes random keys, checking the table
+   against a simple array after each step, so that growing,
+   shrinking, and backward-shift deletion all get exercised, then
+   compares the cost of lookups against the chained table in
+   lib/kernel/hash.c.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <debug.h>
+#include <hash.h>
+#include <ohash.h>
+#include <random.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "threads/test.h"
+
+/* Number of distinct keys that we will test. */
+#define KEY_CNT 512
+
+/* Number of elements for the benchmark. */
+#define BENCH_SIZE 2048
+
+/* Number of lookups per element in the benchmark. */
+#define BENCH_ROUNDS 8
+
+/* A value stored in the table. */
+struct value
+  {
+    struct hash_elem elem;      /* Hash element, for the benchmark. */
+    uintptr_t key;              /* Key. */
+    bool in_table;              /* In the table now? */
+  };
+
+static struct value values[BENCH_SIZE];
+
+static void count_action (uintptr_t key, void *value, void *aux);
+static hash_hash_func value_hash;
+static hash_less_func value_less;
+static void benchmark (size_t size);
+
+/* Test the open-addressed hash table implementation. */
+void
+test (void)
+{
+  struct ohash h;
+  size_t cnt = 0;
+  size_t applied;
+  int i;
+
+  printf ("testing random insertions and deletions...");
+  ASSERT (ohash_init (&h));
+  for (i = 0; i < KEY_CNT; i++)
+    {
+      /* Page-aligned keys, like the user addresses a
+         supplemental page table maps, so that the low bits do
+         not help the hash. */
+      values[i].key = (uintptr_t) i << 12;
+      values[i].in_table = false;
+    }
+
+  for (i = 0; i < KEY_CNT * 40; i++)
+    {
+      /* Favor insertion for the first half and deletion for the
+         second, so that the table both grows and shrinks. */
+      bool grow = i < KEY_CNT * 20;
+      struct value *v = &values[random_ulong () % KEY_CNT];
+      int j;
+
+      if (!v->in_table && (grow || random_ulong () % 4 == 0))
+        {
+          ASSERT (ohash_insert (&h, v->key, v));
+          ASSERT (!ohash_insert (&h, v->key, v));
+          v->in_table = true;
+          cnt++;
+        }
+      else if (v->in_table && (!grow || random_ulong () % 4 == 0))
+        {
+          ASSERT (ohash_delete (&h, v->key) == v);
+          ASSERT (ohash_delete (&h, v->key) == NULL);
+          v->in_table = false;
+          cnt--;
+        }
+
+      ASSERT (ohash_size (&h) == cnt);
+      ASSERT (h.elem_cnt * 4 <= h.slot_cnt * 3);
+      for (j = 0; j < KEY_CNT; j++)
+        ASSERT (ohash_find (&h, values[j].key)
+                == (values[j].in_table ? &values[j] : NULL));
+    }
+
+  applied = 0;
+  ohash_apply (&h, count_action, &applied);
+  ASSERT (applied == cnt);
+
+  ohash_clear (&h);
+  ASSERT (ohash_size (&h) == 0);
+  for (i = 0; i < KEY_CNT; i++)
+    ASSERT (ohash_find (&h, values[i].key) == NULL);
+  ohash_destroy (&h);
+  printf (" done\n");
+
+  benchmark (BENCH_SIZE / 8);
+  benchmark (BENCH_SIZE);
+  printf ("ohash: PASS\n");
+}
+
+/* Checks that VALUE is stored under KEY and counts it in *AUX. */
+static void
+count_action (uintptr_t key, void *value_, void *aux)
+{
+  struct value *value = value_;
+  size_t *cnt = aux;
+
+  ASSERT (value->key == key && value->in_table);
+  (*cnt)++;
+}
+
+/* Returns a hash of value E's key. */
+static unsigned
+value_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct value *v = hash_entry (e, struct value, elem);
+  return hash_bytes (&v->key, sizeof v->key);
+}
+
+/* Returns true if value A's key is less than value B's. */
+static bool
+value_less (const struct hash_elem *a_, const struct hash_elem *b_,
+            void *aux UNUSED)
+{
+  const struct value *a = hash_entry (a_, struct value, elem);
+  const struct value *b = hash_entry (b_, struct value, elem);
+
+  return a->key < b->key;
+}
+
+/* Returns the CPU's time-stamp counter. */
+static inline uint64_t
+rdtsc (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* Prints the cycles per lookup in tables of SIZE page-aligned
+   keys, with the open-addressed table and with the chained
+   one. */
+static void
+benchmark (size_t size)
+{
+  struct ohash oh;
+  struct hash h;
+  uint64_t start, ohash_cycles, hash_cycles;
+  size_t lookup_cnt = size * BENCH_ROUNDS;
+  size_t i;
+
+  ASSERT (size <= BENCH_SIZE);
+  ASSERT (ohash_init (&oh));
+  ASSERT (hash_init (&h, value_hash, value_less, NULL));
+  for (i = 0; i < size; i++)
+    {
+      values[i].key = (uintptr_t) i << 12;
+      ASSERT (ohash_insert (&oh, values[i].key, &values[i]));
+      hash_insert (&h, &values[i].elem);
+    }
+
+  start = rdtsc ();
+  for (i = 0; i < lookup_cnt; i++)
+    ASSERT (ohash_find (&oh, values[(i * 7) % size].key) != NULL);
+  ohash_cycles = rdtsc () - start;
+
+  start = rdtsc ();
+  for (i = 0; i < lookup_cnt; i++)
+    ASSERT (hash_find (&h, &values[(i * 7) % size].elem) != NULL);
+  hash_cycles = rdtsc () - start;
+
+  printf ("ohash: %zu elements: %llu cycles/lookup (hash: %llu)\n",
+          size, ohash_cycles / lookup_cnt, hash_cycles / lookup_cnt);
+
+  ohash_destroy (&oh);
+  hash_destroy (&h, NULL);
+}
@@ -0,0 +1,229 @@
+/* Test program and benchmark for lib/kernel/rbtree.c.
+
+   Inserts and removes random values, checking the red-black
+   invariants and the iteration order after each step, then
+   compares the cost of keeping a sorted collection with
+   rb_insert() against list_insert_ordered().
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <debug.h>
+#include <list.h>
+#include <random.h>
+#include <rbtree.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "threads/test.h"
+
+/* Maximum number of elements in a tree that we will test. */
+#define MAX_SIZE 256
+
+/* Number of elements for the benchmark. */
+#define BENCH_SIZE 2048
+
+/* A tree element. */
+struct value
+  {
+    struct rb_elem rb_elem;     /* Tree element. */
+    struct list_elem elem;      /* List element, for the benchmark. */
+    int value;                  /* Item value. */
+    int seq;                    /* Insertion order. */
+    bool in_tree;               /* In the tree now? */
+  };
+
+static struct value values[BENCH_SIZE];
+
+static bool value_less (const struct rb_elem *, const struct rb_elem *,
+                        void *);
+static bool value_list_less (const struct list_elem *,
+                             const struct list_elem *, void *);
+static int verify_subtree (const struct rb_elem *, const struct rb_elem *);
+static void verify_tree (const struct rbtree *, size_t size);
+static void benchmark (size_t size);
+
+/* Test the red-black tree implementation. */
+void
+test (void)
+{
+  int size;
+
+  printf ("testing various size trees:");
+  for (size = 1; size <= MAX_SIZE; size *= 2)
+    {
+      struct rbtree tree;
+      size_t cnt = 0;
+      int seq = 0;
+      int i;
+
+      printf (" %d", size);
+      rb_init (&tree, value_less, NULL);
+      for (i = 0; i < size; i++)
+        values[i].in_tree = false;
+
+      for (i = 0; i < size * 20; i++)
+        {
+          struct value *v = &values[random_ulong () % size];
+
+          if (!v->in_tree)
+            {
+              /* Values repeat, so that equal elements get tested. */
+              v->value = random_ulong () % (size / 2 + 1);
+              v->seq = seq++;
+              rb_insert (&tree, &v->rb_elem);
+              cnt++;
+            }
+          else
+            {
+              struct value key;
+              struct rb_elem *e;
+
+              /* rb_find() must return the first of the equal
+                 values, which may or may not be V. */
+              key.value = v->value;
+              e = rb_find (&tree, &key.rb_elem);
+              ASSERT (e != NULL);
+              ASSERT (rb_entry (e, struct value, rb_elem)->value == v->value);
+              ASSERT (rb_prev (e) == NULL
+                      || value_less (rb_prev (e), e, NULL));
+
+              rb_remove (&tree, &v->rb_elem);
+              cnt--;
+            }
+          v->in_tree = !v->in_tree;
+          verify_tree (&tree, cnt);
+        }
+    }
+  printf (" done\n");
+
+  benchmark (BENCH_SIZE / 8);
+  benchmark (BENCH_SIZE);
+  printf ("rbtree: PASS\n");
+}
+
+/* Returns true if value A is less than value B, false
+   otherwise. */
+static bool
+value_less (const struct rb_elem *a_, const struct rb_elem *b_,
+            void *aux UNUSED)
+{
+  const struct value *a = rb_entry (a_, struct value, rb_elem);
+  const struct value *b = rb_entry (b_, struct value, rb_elem);
+
+  return a->value < b->value;
+}
+
+/* Returns true if value A is less than value B, false
+   otherwise. */
+static bool
+value_list_less (const struct list_elem *a_, const struct list_elem *b_,
+                 void *aux UNUSED)
+{
+  const struct value *a = list_entry (a_, struct value, elem);
+  const struct value *b = list_entry (b_, struct value, elem);
+
+  return a->value < b->value;
+}
+
+/* Verifies the red-black properties of the subtree rooted at E,
+   whose parent should be PARENT, and returns its black
+   height. */
+static int
+verify_subtree (const struct rb_elem *e, const struct rb_elem *parent)
+{
+  int left, right;
+
+  if (e == NULL)
+    return 1;
+
+  ASSERT (e->parent == parent);
+  ASSERT (!e->red || ((e->left == NULL || !e->left->red)
+                      && (e->right == NULL || !e->right->red)));
+
+  left = verify_subtree (e->left, e);
+  right = verify_subtree (e->right, e);
+  ASSERT (left == right);
+  return left + !e->red;
+}
+
+/* Verifies that TREE is a valid red-black tree of SIZE elements
+   that iterates in order, with equal values in insertion order,
+   both forward and backward. */
+static void
+verify_tree (const struct rbtree *tree, size_t size)
+{
+  const struct rb_elem *e, *prev;
+  size_t cnt;
+
+  ASSERT (rb_size (tree) == size);
+  ASSERT (rb_empty (tree) == (size == 0));
+  ASSERT (tree->root == NULL || !tree->root->red);
+  verify_subtree (tree->root, NULL);
+
+  cnt = 0;
+  prev = NULL;
+  for (e = rb_min (tree); e != NULL; e = rb_next (e))
+    {
+      if (prev != NULL)
+        {
+          const struct value *a = rb_entry (prev, struct value, rb_elem);
+          const struct value *b = rb_entry (e, struct value, rb_elem);
+          ASSERT (a->value < b->value
+                  || (a->value == b->value && a->seq < b->seq));
+        }
+      prev = e;
+      cnt++;
+    }
+  ASSERT (cnt == size);
+  ASSERT (prev == rb_max (tree));
+
+  for (e = rb_max (tree); e != NULL; e = rb_prev (e))
+    cnt--;
+  ASSERT (cnt == 0);
+}
+
+/* Returns the CPU's time-stamp counter. */
+static inline uint64_t
+rdtsc (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* Prints the cycles taken to build a sorted collection of SIZE
+   random values and then take it apart in random order, with a
+   tree and with an ordered list. */
+static void
+benchmark (size_t size)
+{
+  struct rbtree tree;
+  struct list list;
+  uint64_t start, tree_cycles, list_cycles;
+  size_t i;
+
+  ASSERT (size <= BENCH_SIZE);
+  for (i = 0; i < size; i++)
+    values[i].value = random_ulong ();
+
+  start = rdtsc ();
+  rb_init (&tree, value_less, NULL);
+  for (i = 0; i < size; i++)
+    rb_insert (&tree, &values[i].rb_elem);
+  for (i = 0; i < size; i++)
+    rb_remove (&tree, &values[(i * 7) % size].rb_elem);
+  tree_cycles = rdtsc () - start;
+
+  start = rdtsc ();
+  list_init (&list);
+  for (i = 0; i < size; i++)
+    list_insert_ordered (&list, &values[i].elem, value_list_less, NULL);
+  for (i = 0; i < size; i++)
+    list_remove (&values[(i * 7) % size].elem);
+  list_cycles = rdtsc () - start;
+
+  printf ("rbtree: %zu elements: %llu cycles/element (list: %llu)\n",
+          size, tree_cycles / size, list_cycles / size);
+}
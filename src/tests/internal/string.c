@@ -0,0 +1,253 @@
+/* Test program and microbenchmark for the memory and string
+   primitives in lib/string.c.
+
+   Checks memcpy(), memmove(), memset(), memcmp(), memchr(), and
+   strlen() against simple byte-at-a-time versions for many
+   sizes and alignments, then times both versions of each on
+   small and page-sized blocks.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <debug.h>
+#include <random.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/test.h"
+
+/* Largest block that we will test, and number of alignments
+   to try for each end. */
+#define MAX_SIZE 300
+#define ALIGNS 8
+
+/* Number of repetitions for each timing. */
+#define ROUNDS 1000
+
+static unsigned char src[MAX_SIZE + 2 * ALIGNS + 4096];
+static unsigned char dst[MAX_SIZE + 2 * ALIGNS + 4096];
+static unsigned char ref[MAX_SIZE + 2 * ALIGNS + 4096];
+
+static void test_copies (void);
+static void test_searches (void);
+static void benchmark (size_t size);
+
+static void byte_memmove (void *, const void *, size_t);
+static int byte_memcmp (const void *, const void *, size_t);
+static void *byte_memchr (const void *, int, size_t);
+static size_t byte_strlen (const char *);
+
+/* Test and time the string primitives. */
+void
+test (void)
+{
+  test_copies ();
+  test_searches ();
+  printf ("string: correctness PASS\n");
+
+  benchmark (16);
+  benchmark (256);
+  benchmark (4096);
+  printf ("string: PASS\n");
+}
+
+/* Returns the CPU's time-stamp counter. */
+static inline uint64_t
+rdtsc (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* Checks memcpy(), memmove(), and memset() for every size up to
+   MAX_SIZE and a range of source and destination alignments,
+   including overlapping moves in both directions. */
+static void
+test_copies (void)
+{
+  size_t size, so, dof;
+
+  for (size = 0; size <= MAX_SIZE; size = size < 40 ? size + 1 : size * 3 / 2)
+    for (so = 0; so < ALIGNS; so++)
+      for (dof = 0; dof < ALIGNS; dof++)
+        {
+          random_bytes (src, sizeof src);
+
+          /* Non-overlapping copy. */
+          memcpy (ref, src, sizeof src);
+          memcpy (dst, src, sizeof src);
+          byte_memmove (ref + MAX_SIZE + ALIGNS + dof, ref + so, size);
+          ASSERT (memcpy (dst + MAX_SIZE + ALIGNS + dof, dst + so, size)
+                  == dst + MAX_SIZE + ALIGNS + dof);
+          ASSERT (!byte_memcmp (ref, dst, sizeof ref));
+
+          /* Overlapping moves, forward and backward. */
+          byte_memmove (ref + dof, ref + so, size);
+          ASSERT (memmove (dst + dof, dst + so, size) == dst + dof);
+          ASSERT (!byte_memcmp (ref, dst, sizeof ref));
+
+          /* Fill. */
+          {
+            size_t i;
+            for (i = 0; i < size; i++)
+              ref[dof + i] = (unsigned char) (so + size);
+          }
+          ASSERT (memset (dst + dof, so + size, size) == dst + dof);
+          ASSERT (!byte_memcmp (ref, dst, sizeof ref));
+        }
+}
+
+/* Checks memcmp(), memchr(), and strlen() for every size up to
+   MAX_SIZE and a range of alignments. */
+static void
+test_searches (void)
+{
+  size_t size, ofs;
+
+  for (size = 0; size <= MAX_SIZE; size = size < 40 ? size + 1 : size * 3 / 2)
+    for (ofs = 0; ofs < ALIGNS; ofs++)
+      {
+        size_t i;
+        int ch;
+
+        random_bytes (src, sizeof src);
+        memcpy (dst, src, sizeof src);
+
+        /* Equal blocks, then blocks that differ at one byte. */
+        ASSERT (memcmp (src + ofs, dst + ofs, size) == 0);
+        if (size > 0)
+          {
+            i = random_ulong () % size;
+            dst[ofs + i] ^= 1 + random_ulong () % 255;
+            ASSERT ((memcmp (src + ofs, dst + ofs, size) > 0)
+                    == (byte_memcmp (src + ofs, dst + ofs, size) > 0));
+            ASSERT (memcmp (src + ofs, dst + ofs, size) != 0);
+          }
+
+        /* A byte that is present, and one that may not be. */
+        ch = size > 0 ? src[ofs + random_ulong () % size] : 0;
+        ASSERT (memchr (src + ofs, ch, size)
+                == byte_memchr (src + ofs, ch, size));
+        ch = random_ulong () % 256;
+        ASSERT (memchr (src + ofs, ch, size)
+                == byte_memchr (src + ofs, ch, size));
+
+        /* A string of exactly SIZE nonzero characters. */
+        for (i = 0; i < size; i++)
+          if (src[ofs + i] == '\0')
+            src[ofs + i] = 1;
+        src[ofs + size] = '\0';
+        ASSERT (strlen ((char *) src + ofs) == size);
+      }
+}
+
+/* Prints the average number of cycles taken by each primitive,
+   and by its byte-at-a-time counterpart, on SIZE-byte blocks. */
+static void
+benchmark (size_t size)
+{
+  uint64_t start, fast, slow;
+  int i;
+
+#define TIME(VAR, STMT)                         \
+  do                                            \
+    {                                           \
+      start = rdtsc ();                         \
+      for (i = 0; i < ROUNDS; i++)              \
+        STMT;                                   \
+      VAR = (rdtsc () - start) / ROUNDS;        \
+    }                                           \
+  while (0)
+
+  memset (src, 'x', size);
+  src[size] = '\0';
+  memcpy (dst, src, size + 1);
+
+  printf ("string: %zu-byte blocks, cycles per call (byte loop):\n", size);
+
+  TIME (fast, memcpy (dst, src, size));
+  TIME (slow, byte_memmove (dst, src, size));
+  printf ("  memcpy  %6llu (%6llu)\n", fast, slow);
+
+  TIME (fast, memmove (dst + 1, dst, size));
+  TIME (slow, byte_memmove (dst + 1, dst, size));
+  printf ("  memmove %6llu (%6llu)\n", fast, slow);
+
+  TIME (fast, memset (dst, 0, size));
+  TIME (slow, { size_t j; for (j = 0; j < size; j++) dst[j] = 0; });
+  printf ("  memset  %6llu (%6llu)\n", fast, slow);
+
+  memcpy (dst, src, size + 1);
+  TIME (fast, ASSERT (memcmp (dst, src, size) == 0));
+  TIME (slow, ASSERT (byte_memcmp (dst, src, size) == 0));
+  printf ("  memcmp  %6llu (%6llu)\n", fast, slow);
+
+  TIME (fast, ASSERT (memchr (src, 'y', size) == NULL));
+  TIME (slow, ASSERT (byte_memchr (src, 'y', size) == NULL));
+  printf ("  memchr  %6llu (%6llu)\n", fast, slow);
+
+  TIME (fast, ASSERT (strlen ((char *) src) == size));
+  TIME (slow, ASSERT (byte_strlen ((char *) src) == size));
+  printf ("  strlen  %6llu (%6llu)\n", fast, slow);
+
+#undef TIME
+}
+
+/* Byte-at-a-time memmove(). */
+static void
+byte_memmove (void *dst_, const void *src_, size_t size)
+{
+  unsigned char *d = dst_;
+  const unsigned char *s = src_;
+
+  if (d < s)
+    while (size-- > 0)
+      *d++ = *s++;
+  else
+    {
+      d += size;
+      s += size;
+      while (size-- > 0)
+        *--d = *--s;
+    }
+}
+
+/* Byte-at-a-time memcmp(). */
+static int
+byte_memcmp (const void *a_, const void *b_, size_t size)
+{
+  const unsigned char *a = a_;
+  const unsigned char *b = b_;
+
+  for (; size-- > 0; a++, b++)
+    if (*a != *b)
+      return *a > *b ? +1 : -1;
+  return 0;
+}
+
+/* Byte-at-a-time memchr(). */
+static void *
+byte_memchr (const void *block_, int ch_, size_t size)
+{
+  const unsigned char *block = block_;
+  unsigned char ch = ch_;
+
+  for (; size-- > 0; block++)
+    if (*block == ch)
+      return (void *) block;
+  return NULL;
+}
+
+/* Byte-at-a-time strlen(). */
+static size_t
+byte_strlen (const char *string)
+{
+  const char *p;
+
+  for (p = string; *p != '\0'; p++)
+    continue;
+  return p - string;
+}
@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rwlock-readers) begin
+(rwlock-readers) reader 0: got the lock
+(rwlock-readers) reader 0: done
+(rwlock-readers) reader 1: got the lock
+(rwlock-readers) reader 1: done
+(rwlock-readers) reader 2: got the lock
+(rwlock-readers) reader 2: done
+(rwlock-readers) Main thread releasing the lock.
+(rwlock-readers) writer: got the lock
+(rwlock-readers) writer: done
+(rwlock-readers) Writer must already have finished.
+(rwlock-readers) end
+EOF
+pass;
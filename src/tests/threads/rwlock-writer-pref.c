@@ -0,0 +1,59 @@
+/* The main thread acquires a readers-writer lock for reading.
+   Then it creates a writer, which blocks waiting for the main
+   thread to leave, and after that a reader of even higher
+   priority.  Although the lock is only held for reading, the new
+   reader must wait behind the writer, donating its priority to
+   it.  When the main thread releases the lock, the writer should
+   run first, followed by the reader. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+static thread_func reader_thread_func;
+static thread_func writer_thread_func;
+
+void
+test_rwlock_writer_pref (void) 
+{
+  struct rwlock rw;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  rwlock_init (&rw);
+  rwlock_acquire_read (&rw);
+  thread_create ("writer", PRI_DEFAULT + 1, writer_thread_func, &rw);
+  msg ("Writer is waiting for the lock.");
+  thread_create ("reader", PRI_DEFAULT + 2, reader_thread_func, &rw);
+  msg ("Reader is waiting behind the writer.");
+  rwlock_release_read (&rw);
+  msg ("Writer, reader must already have finished, in that order.");
+}
+
+static void
+reader_thread_func (void *rw_) 
+{
+  struct rwlock *rw = rw_;
+
+  rwlock_acquire_read (rw);
+  msg ("reader: got the lock");
+  rwlock_release_read (rw);
+  msg ("reader: done");
+}
+
+static void
+writer_thread_func (void *rw_) 
+{
+  struct rwlock *rw = rw_;
+
+  rwlock_acquire_write (rw);
+  msg ("writer: got the lock with priority %d", thread_get_priority ());
+  rwlock_release_write (rw);
+  msg ("writer: done");
+}
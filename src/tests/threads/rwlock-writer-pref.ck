@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rwlock-writer-pref) begin
+(rwlock-writer-pref) Writer is waiting for the lock.
+(rwlock-writer-pref) Reader is waiting behind the writer.
+(rwlock-writer-pref) writer: got the lock with priority 33
+(rwlock-writer-pref) reader: got the lock
+(rwlock-writer-pref) reader: done
+(rwlock-writer-pref) writer: done
+(rwlock-writer-pref) Writer, reader must already have finished, in that order.
+(rwlock-writer-pref) end
+EOF
+pass;
@@ -0,0 +1,35 @@
+#include "threads/cpu.h"
+#include <debug.h>
+#include "threads/interrupt.h"
+
+/* CPUs that are up and scheduling threads. */
+struct cpu cpus[CPU_MAX];
+int cpu_cnt;
+
+/* Sets up the per-CPU data for the bootstrap processor.
+
+   Only the bootstrap processor is brought up.  Starting the
+   application processors also requires a real-mode trampoline,
+   the local APIC mapped into kernel virtual memory, and a way to
+   tell the CPUs apart.  It further requires that every lock in
+   the kernel stop relying on intr_disable() for mutual
+   exclusion. */
+void
+cpu_init (void)
+{
+  struct cpu *c = &cpus[0];
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  c->id = 0;
+  c->idle_thread = NULL;
+  cpu_cnt = 1;
+}
+
+/* Returns the CPU we are running on.  Only the bootstrap
+   processor is running, so that is always cpus[0]. */
+struct cpu *
+cpu_current (void)
+{
+  return &cpus[0];
+}
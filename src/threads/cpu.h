@@ -0,0 +1,45 @@
+#ifndef THREADS_CPU_H
+#define THREADS_CPU_H
+
+#include <list.h>
+#include <stdint.h>
+#include "threads/thread.h"
+
+/* Maximum number of CPUs. */
+#define CPU_MAX 8
+
+/* Threads in THREAD_READY state that are queued on one CPU, that
+   is, threads that are ready to run but not actually running.
+   There is one FIFO list per priority level, and bit N of
+   `nonempty' is set exactly when lists[N] is nonempty, so that
+   both inserting a thread and finding the highest-priority
+   ready thread take constant time. */
+struct ready_queue
+  {
+    struct list lists[PRI_MAX + 1];     /* Ready threads by priority. */
+    uint64_t nonempty;                  /* Bitmap of nonempty lists. */
+    int cnt;                            /* Number of ready threads. */
+  };
+
+/* Per-CPU data.
+
+   Each CPU schedules from its own ready queue, so that CPUs do
+   not contend for a single queue.  Only the bootstrap processor
+   is brought up so far (see cpu_init()), so a queue is only ever
+   touched by its own CPU and disabling interrupts is enough to
+   protect it. */
+struct cpu
+  {
+    int id;                             /* Index into cpus[]. */
+    struct thread *idle_thread;         /* Runs when rq is empty. */
+    struct ready_queue rq;              /* Threads ready to run here. */
+  };
+
+/* CPUs that are up and scheduling threads. */
+extern struct cpu cpus[CPU_MAX];
+extern int cpu_cnt;
+
+void cpu_init (void);
+struct cpu *cpu_current (void);
+
+#endif /* threads/cpu.h */
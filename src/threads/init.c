@@ -19,7 +19,10 @@
 #include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/pte.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
 #include "threads/thread.h"
+#include "threads/vmalloc.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #include "userprog/exception.h"
@@ -31,6 +34,7 @@
 #endif
 #ifdef FILESYS
 #include "devices/disk.h"
+#include "filesys/cache.h"
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
 #endif
@@ -87,6 +91,7 @@ main (void)
   palloc_init ();
   malloc_init ();
   paging_init ();
+  vmalloc_init ();
 
   /* Segmentation. */
 #ifdef USERPROG
@@ -108,6 +113,7 @@ main (void)
   thread_start ();
   serial_init_queue ();
   timer_calibrate ();
+  palloc_start_zeroing ();
 
 #ifdef FILESYS
   /* Initialize file system. */
@@ -244,6 +250,10 @@ parse_options (char **argv)
         random_init (atoi (value));
       else if (!strcmp (name, "-mlfqs"))
         thread_mlfqs = true;
+      else if (!strcmp (name, "-tickless"))
+        timer_tickless = true;
+      else if (!strcmp (name, "-trace"))
+        thread_trace_enabled = true;
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
@@ -349,6 +359,8 @@ usage (void)
           "  -f                 Format file system disk during startup.\n"
           "  -rs=SEED           Set random number seed to SEED.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
+          "  -tickless          Stop the timer tick while idle.\n"
+          "  -trace             Dump a scheduler trace to serial at exit.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
 #endif
@@ -370,6 +382,7 @@ power_off (void)
 #endif
 
   print_stats ();
+  thread_trace_dump ();
 
   printf ("Powering off...\n");
   serial_flush ();
@@ -387,7 +400,10 @@ print_stats (void)
 {
   timer_print_stats ();
   thread_print_stats ();
+  lock_print_stats ();
+  kmem_cache_print_stats ();
 #ifdef FILESYS
+  cache_print_stats ();
   disk_print_stats ();
 #endif
   console_print_stats ();
@@ -35,6 +35,11 @@ static const char *intr_names[INTR_CNT];
 static bool in_external_intr;   /* Are we processing an external interrupt? */
 static bool yield_on_return;    /* Should we yield on interrupt return? */
 
+/* Called at the start of every external interrupt, before the
+   interrupt's own handler, if nonnull.  See
+   intr_register_entry(). */
+static intr_entry_func *entry_func;
+
 /* Programmable Interrupt Controller helpers. */
 static void pic_init (void);
 static void pic_end_of_interrupt (int irq);
@@ -172,6 +177,18 @@ intr_register_ext (uint8_t vec_no, intr_handler_func *handler,
   register_handler (vec_no, 0, INTR_OFF, handler, name);
 }
 
+/* Registers FUNC to be called with interrupts disabled at the
+   start of every external interrupt, before the interrupt's own
+   handler runs.  FUNC runs in external interrupt context, so it
+   may call intr_yield_on_return() but may not sleep.  Only one
+   such function may be registered. */
+void
+intr_register_entry (intr_entry_func *func)
+{
+  ASSERT (entry_func == NULL);
+  entry_func = func;
+}
+
 /* Registers internal interrupt VEC_NO to invoke HANDLER, which
    is named NAME for debugging purposes.  The interrupt handler
    will be invoked with interrupt status LEVEL.
@@ -353,6 +370,9 @@ intr_handler (struct intr_frame *frame)
 
       in_external_intr = true;
       yield_on_return = false;
+
+      if (entry_func != NULL)
+        entry_func ();
     }
 
   /* Invoke the interrupt's handler. */
@@ -5,9 +5,12 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/cpu.h"
+#include "threads/interrupt.h"
 #include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
+#include "threads/vmalloc.h"
 
 /* A simple implementation of malloc().
 
@@ -32,7 +35,19 @@
    because they're too big to fit in a single page with a
    descriptor.  We handle those by allocating contiguous pages
    with the page allocator and sticking the allocation size at
-   the beginning of the allocated block's arena header. */
+   the beginning of the allocated block's arena header.  If the
+   page allocator has no run of contiguous pages that long, we
+   fall back to vmalloc(), which maps scattered pages at
+   contiguous virtual addresses.
+
+   In front of the descriptors, each CPU has a "magazine" of free
+   blocks for each block size: a small stack of pointers that
+   malloc() pops from and free() pushes onto with interrupts
+   briefly disabled, but without taking the descriptor's lock.
+   Only when a magazine runs empty or full do we take the lock,
+   to move half a magazine's worth of blocks from or to the
+   descriptor at once.  Blocks in a magazine still count as in
+   use as far as their arena is concerned. */
 
 /* Descriptor. */
 struct desc
@@ -64,6 +79,24 @@ struct block
 static struct desc descs[10];   /* Descriptors. */
 static size_t desc_cnt;         /* Number of descriptors. */
 
+/* Number of blocks a magazine holds, and the number moved
+   between a magazine and its descriptor at a time. */
+#define MAG_SIZE 16
+#define MAG_BATCH (MAG_SIZE / 2)
+
+/* Per-CPU cache of free blocks of one size. */
+struct magazine
+  {
+    struct block *blocks[MAG_SIZE]; /* Free blocks. */
+    size_t cnt;                 /* Number of blocks in BLOCKS. */
+  };
+
+/* Magazines, by CPU and descriptor. */
+static struct magazine mags[CPU_MAX][sizeof descs / sizeof *descs];
+
+static struct magazine *current_magazine (struct desc *);
+static struct block *desc_get_block (struct desc *);
+static void desc_put_block (struct desc *, struct block *);
 static struct arena *block_to_arena (struct block *);
 static struct block *arena_to_block (struct arena *, size_t idx);
 
@@ -80,7 +113,7 @@ malloc_init (void)
       d->block_size = block_size;
       d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
       list_init (&d->free_list);
-      lock_init (&d->lock);
+      lock_init_named (&d->lock, "malloc");
     }
 }
 
@@ -92,6 +125,8 @@ malloc (size_t size)
   struct desc *d;
   struct block *b;
   struct arena *a;
+  struct magazine *m;
+  enum intr_level old_level;
 
   /* A null pointer satisfies a request for 0 bytes. */
   if (size == 0)
@@ -108,6 +143,8 @@ malloc (size_t size)
          Allocate enough pages to hold SIZE plus an arena. */
       size_t page_cnt = DIV_ROUND_UP (size + sizeof *a, PGSIZE);
       a = palloc_get_multiple (0, page_cnt);
+      if (a == NULL)
+        a = vmalloc (page_cnt);
       if (a == NULL)
         return NULL;
 
@@ -119,36 +156,42 @@ malloc (size_t size)
       return a + 1;
     }
 
-  lock_acquire (&d->lock);
-
-  /* If the free list is empty, create a new arena. */
-  if (list_empty (&d->free_list))
+  /* Fast path: take a block from this CPU's magazine. */
+  old_level = intr_disable ();
+  m = current_magazine (d);
+  if (m->cnt > 0)
     {
-      size_t i;
-
-      /* Allocate a page. */
-      a = palloc_get_page (0);
-      if (a == NULL) 
-        {
-          lock_release (&d->lock);
-          return NULL; 
-        }
-
-      /* Initialize arena and add its blocks to the free list. */
-      a->magic = ARENA_MAGIC;
-      a->desc = d;
-      a->free_cnt = d->blocks_per_arena;
-      for (i = 0; i < d->blocks_per_arena; i++) 
-        {
-          struct block *b = arena_to_block (a, i);
-          list_push_back (&d->free_list, &b->free_elem);
-        }
+      b = m->blocks[--m->cnt];
+      intr_set_level (old_level);
+      return b;
     }
+  intr_set_level (old_level);
 
-  /* Get a block from free list and return it. */
-  b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
-  a = block_to_arena (b);
-  a->free_cnt--;
+  /* Slow path: get a batch of blocks from the descriptor, keep
+     one, and load the rest into the magazine.  Only the first
+     block may need a new arena; the rest come from blocks that
+     are already free. */
+  lock_acquire (&d->lock);
+  b = desc_get_block (d);
+  if (b != NULL)
+    {
+      struct block *batch[MAG_BATCH];
+      size_t i, cnt;
+
+      for (cnt = 0; cnt < MAG_BATCH && !list_empty (&d->free_list); cnt++)
+        batch[cnt] = desc_get_block (d);
+
+      old_level = intr_disable ();
+      m = current_magazine (d);
+      for (i = 0; i < cnt && m->cnt < MAG_SIZE; i++)
+        m->blocks[m->cnt++] = batch[i];
+      intr_set_level (old_level);
+
+      /* Another thread on this CPU may have refilled the
+         magazine while we were getting the batch. */
+      for (; i < cnt; i++)
+        desc_put_block (d, batch[i]);
+    }
   lock_release (&d->lock);
   return b;
 }
@@ -227,42 +270,136 @@ free (void *p)
       if (d != NULL) 
         {
           /* It's a normal block.  We handle it here. */
+          struct block *batch[MAG_BATCH + 1];
+          size_t i, cnt = 0;
+          struct magazine *m;
+          enum intr_level old_level;
 
 #ifndef NDEBUG
           /* Clear the block to help detect use-after-free bugs. */
           memset (b, 0xcc, d->block_size);
 #endif
   
-          lock_acquire (&d->lock);
-
-          /* Add block to free list. */
-          list_push_front (&d->free_list, &b->free_elem);
-
-          /* If the arena is now entirely unused, free it. */
-          if (++a->free_cnt >= d->blocks_per_arena) 
+          /* Fast path: put the block in this CPU's magazine. */
+          old_level = intr_disable ();
+          m = current_magazine (d);
+          if (m->cnt < MAG_SIZE)
             {
-              size_t i;
-
-              ASSERT (a->free_cnt == d->blocks_per_arena);
-              for (i = 0; i < d->blocks_per_arena; i++) 
-                {
-                  struct block *b = arena_to_block (a, i);
-                  list_remove (&b->free_elem);
-                }
-              palloc_free_page (a);
+              m->blocks[m->cnt++] = b;
+              intr_set_level (old_level);
+              return;
             }
+          intr_set_level (old_level);
 
+          /* Slow path: the magazine is full, so give a batch of
+             its blocks, plus this one if there is still no room
+             for it, back to the descriptor. */
+          lock_acquire (&d->lock);
+          old_level = intr_disable ();
+          m = current_magazine (d);
+          while (cnt < MAG_BATCH && m->cnt > 0)
+            batch[cnt++] = m->blocks[--m->cnt];
+          if (m->cnt < MAG_SIZE)
+            m->blocks[m->cnt++] = b;
+          else
+            batch[cnt++] = b;
+          intr_set_level (old_level);
+
+          for (i = 0; i < cnt; i++)
+            desc_put_block (d, batch[i]);
           lock_release (&d->lock);
         }
       else
         {
           /* It's a big block.  Free its pages. */
-          palloc_free_multiple (a, a->free_cnt);
+          if (is_vmalloc_vaddr (a))
+            vfree (a);
+          else
+            palloc_free_multiple (a, a->free_cnt);
           return;
         }
     }
 }
 
+/* Returns the running CPU's magazine for descriptor D.
+   Interrupts must be off, so that we stay on this CPU for as
+   long as we use the magazine. */
+static struct magazine *
+current_magazine (struct desc *d) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  return &mags[cpu_current ()->id][d - descs];
+}
+
+/* Removes and returns a block from D's free list, first creating
+   a new arena if the list is empty.  Returns a null pointer if
+   no memory is available for a new arena.  D's lock must be
+   held. */
+static struct block *
+desc_get_block (struct desc *d) 
+{
+  struct arena *a;
+  struct block *b;
+
+  ASSERT (lock_held_by_current_thread (&d->lock));
+
+  /* If the free list is empty, create a new arena. */
+  if (list_empty (&d->free_list))
+    {
+      size_t i;
+
+      /* Allocate a page. */
+      a = palloc_get_page (0);
+      if (a == NULL) 
+        return NULL; 
+
+      /* Initialize arena and add its blocks to the free list. */
+      a->magic = ARENA_MAGIC;
+      a->desc = d;
+      a->free_cnt = d->blocks_per_arena;
+      for (i = 0; i < d->blocks_per_arena; i++) 
+        {
+          struct block *b = arena_to_block (a, i);
+          list_push_back (&d->free_list, &b->free_elem);
+        }
+    }
+
+  /* Get a block from free list and return it. */
+  b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
+  a = block_to_arena (b);
+  a->free_cnt--;
+  return b;
+}
+
+/* Adds block B to D's free list, giving its arena back to the
+   page allocator if that leaves the arena entirely unused.  D's
+   lock must be held. */
+static void
+desc_put_block (struct desc *d, struct block *b) 
+{
+  struct arena *a = block_to_arena (b);
+
+  ASSERT (lock_held_by_current_thread (&d->lock));
+
+  /* Add block to free list. */
+  list_push_front (&d->free_list, &b->free_elem);
+
+  /* If the arena is now entirely unused, free it. */
+  if (++a->free_cnt >= d->blocks_per_arena) 
+    {
+      size_t i;
+
+      ASSERT (a->free_cnt == d->blocks_per_arena);
+      for (i = 0; i < d->blocks_per_arena; i++) 
+        {
+          struct block *b = arena_to_block (a, i);
+          list_remove (&b->free_elem);
+        }
+      palloc_free_page (a);
+    }
+}
+
 /* Returns the arena that block B is inside. */
 static struct arena *
 block_to_arena (struct block *b)
@@ -2,15 +2,19 @@
 #include <bitmap.h>
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/loader.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
 #include "threads/vaddr.h"
+#include "devices/timer.h"
 
 /* Page allocator.  Hands out memory in page-size (or
    page-multiple) chunks.  See malloc.h for an allocator that
@@ -24,14 +28,66 @@
 
    By default, half of system RAM is given to the kernel pool and
    half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   kernel pool, but that's just fine for demonstration purposes.
+
+   Within a pool, free pages are managed by a binary buddy
+   allocator.  Free memory is kept as blocks of 2**K pages, for
+   each "order" K, each aligned on a multiple of its own size
+   relative to the pool's base, and each order has its own free
+   list.  A request for N pages takes the smallest free block of
+   at least N pages, splitting larger blocks in half as needed,
+   and gives back the unused tail.  Freeing a block merges it
+   with its "buddy", the other half of the block of the next
+   order up, for as long as the buddy is also free.  Thus, both
+   allocating and freeing take time logarithmic in the pool
+   size, and free memory does not stay fragmented into small
+   blocks once its neighbors are freed.
+
+   The free lists are threaded through the first page of each
+   free block, so the only other memory they need is one byte
+   per page recording the order of the free block that starts
+   there, if any.
+
+   Each pool also keeps a small reserve of free pages that have
+   already been zeroed by a background thread, so that a PAL_ZERO
+   request for a single page, the common case for page
+   directories, stacks, and BSS, does not have to clear it on
+   the allocating thread.  Pages in the reserve are marked as
+   used in the pool's used_map and absent from the free lists.
+   The reserve is given back to the free lists if a request
+   cannot otherwise be satisfied.
+
+   A pool's free lists, used_map, and reserve are protected by
+   disabling interrupts, not by a lock, because schedule_tail()
+   frees a dying thread's page in the middle of a context switch,
+   where it can neither sleep nor tell whether the incoming thread
+   was preempted inside the allocator.  Every critical section is
+   short: a buddy split or merge takes time logarithmic in the
+   pool size, and pages are only ever cleared with interrupts
+   on. */
+
+/* Maximum number of pre-zeroed pages per pool.  The zeroing
+   thread is woken when a pool drops below half of this. */
+#define ZERO_RESERVE 64
+
+/* Number of block orders.  The largest block is 2**(ORDER_CNT - 1)
+   pages, i.e. 2 GB. */
+#define ORDER_CNT 20
 
 /* A memory pool. */
 struct pool
   {
-    struct lock lock;                   /* Mutual exclusion. */
     struct bitmap *used_map;            /* Bitmap of free pages. */
+    uint8_t *orders;                    /* Per page: 1 + order of the
+                                           free block starting there,
+                                           or 0. */
+    struct list free_lists[ORDER_CNT];  /* Free blocks, by order. */
     uint8_t *base;                      /* Base of pool. */
+    size_t page_cnt;                    /* Number of pages in pool. */
+
+    size_t zeroed[ZERO_RESERVE];        /* Indexes of zeroed free pages. */
+    size_t zero_cnt;                    /* Number of pages in zeroed. */
+    size_t zero_max;                    /* Target size of zeroed. */
   };
 
 /* Two pools: one for kernel data, one for user pages. */
@@ -40,9 +96,22 @@ struct pool kernel_pool, user_pool;
 /* Maximum number of pages to put in user pool. */
 size_t user_page_limit = SIZE_MAX;
 
+/* Wakes up the page-zeroing thread.  zero_pending is set while
+   an up is outstanding, so that only one is made per wakeup. */
+static struct semaphore zero_wanted;
+static bool zero_pending;
+
 static void init_pool (struct pool *, void *base, size_t page_cnt,
                        const char *name);
 static bool page_from_pool (const struct pool *, void *page);
+static size_t pool_alloc (struct pool *, size_t page_cnt);
+static bool zero_reserve_release (struct pool *);
+static void zero_reserve_fill (struct pool *);
+static thread_func zero_thread;
+static size_t block_alloc (struct pool *, int order);
+static void block_free (struct pool *, size_t page_idx, int order);
+static void range_free (struct pool *, size_t page_idx, size_t page_cnt);
+static int order_for (size_t page_cnt);
 
 /* Initializes the page allocator. */
 void
@@ -66,6 +135,16 @@ palloc_init (void)
   init_pool (&kernel_pool, free_start, kernel_pages, "kernel pool");
   init_pool (&user_pool, free_start + kernel_pages * PGSIZE,
              user_pages, "user pool");
+  sema_init (&zero_wanted, 0);
+}
+
+/* Starts the thread that keeps each pool's reserve of zeroed
+   pages filled.  Must be called after thread_start(). */
+void
+palloc_start_zeroing (void) 
+{
+  zero_pending = true;
+  thread_create ("pagezero", PRI_MIN, zero_thread, NULL);
 }
 
 /* Obtains and returns a group of PAGE_CNT contiguous free pages.
@@ -78,15 +157,33 @@ void *
 palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
 {
   struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+  bool need_zero = (flags & PAL_ZERO) != 0;
+  enum intr_level old_level;
   void *pages;
   size_t page_idx;
 
   if (page_cnt == 0)
     return NULL;
 
-  lock_acquire (&pool->lock);
-  page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
-  lock_release (&pool->lock);
+  old_level = intr_disable ();
+  if (need_zero && page_cnt == 1 && pool->zero_cnt > 0)
+    {
+      page_idx = pool->zeroed[--pool->zero_cnt];
+      need_zero = false;
+    }
+  else 
+    {
+      page_idx = pool_alloc (pool, page_cnt);
+      if (page_idx == BITMAP_ERROR && zero_reserve_release (pool))
+        page_idx = pool_alloc (pool, page_cnt);
+    }
+  if ((flags & PAL_ZERO) && pool->zero_cnt < pool->zero_max / 2
+      && !zero_pending)
+    {
+      zero_pending = true;
+      sema_up (&zero_wanted);
+    }
+  intr_set_level (old_level);
 
   if (page_idx != BITMAP_ERROR)
     pages = pool->base + PGSIZE * page_idx;
@@ -95,7 +192,7 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
 
   if (pages != NULL) 
     {
-      if (flags & PAL_ZERO)
+      if (need_zero)
         memset (pages, 0, PGSIZE * page_cnt);
     }
   else 
@@ -125,6 +222,7 @@ void
 palloc_free_multiple (void *pages, size_t page_cnt) 
 {
   struct pool *pool;
+  enum intr_level old_level;
   size_t page_idx;
 
   ASSERT (pg_ofs (pages) == 0);
@@ -144,8 +242,11 @@ palloc_free_multiple (void *pages, size_t page_cnt)
   memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
 
+  old_level = intr_disable ();
   ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
   bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+  range_free (pool, page_idx, page_cnt);
+  intr_set_level (old_level);
 }
 
 /* Frees the page at PAGE. */
@@ -160,10 +261,13 @@ palloc_free_page (void *page)
 static void
 init_pool (struct pool *p, void *base, size_t page_cnt, const char *name) 
 {
-  /* We'll put the pool's used_map at its base.
-     Calculate the space needed for the bitmap
-     and subtract it from the pool's size. */
-  size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (page_cnt), PGSIZE);
+  /* We'll put the pool's used_map and orders at its base.
+     Calculate the space needed for them and subtract it from
+     the pool's size. */
+  size_t bm_size = bitmap_buf_size (page_cnt);
+  size_t bm_pages = DIV_ROUND_UP (bm_size + page_cnt, PGSIZE);
+  int order;
+
   if (bm_pages > page_cnt)
     PANIC ("Not enough memory in %s for bitmap.", name);
   page_cnt -= bm_pages;
@@ -171,9 +275,18 @@ init_pool (struct pool *p, void *base, size_t page_cnt, const char *name)
   printf ("%zu pages available in %s.\n", page_cnt, name);
 
   /* Initialize the pool. */
-  lock_init (&p->lock);
-  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_pages * PGSIZE);
+  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_size);
+  p->orders = (uint8_t *) base + bm_size;
+  memset (p->orders, 0, page_cnt);
+  for (order = 0; order < ORDER_CNT; order++)
+    list_init (&p->free_lists[order]);
   p->base = base + bm_pages * PGSIZE;
+  p->page_cnt = page_cnt;
+  p->zero_cnt = 0;
+  p->zero_max = page_cnt / 8 < ZERO_RESERVE ? page_cnt / 8 : ZERO_RESERVE;
+
+  /* Everything starts out free. */
+  range_free (p, 0, page_cnt);
 }
 
 /* Returns true if PAGE was allocated from POOL,
@@ -183,7 +296,214 @@ page_from_pool (const struct pool *pool, void *page)
 {
   size_t page_no = pg_no (page);
   size_t start_page = pg_no (pool->base);
-  size_t end_page = start_page + bitmap_size (pool->used_map);
+  size_t end_page = start_page + pool->page_cnt;
 
   return page_no >= start_page && page_no < end_page;
 }
+
+/* Allocates PAGE_CNT contiguous pages from POOL's free lists
+   and returns the index of the first one, or BITMAP_ERROR if
+   there is no large enough free block.  Interrupts must be
+   off. */
+static size_t
+pool_alloc (struct pool *pool, size_t page_cnt) 
+{
+  int order = order_for (page_cnt);
+  size_t page_idx;
+
+  if (order >= ORDER_CNT)
+    return BITMAP_ERROR;
+  page_idx = block_alloc (pool, order);
+  if (page_idx != BITMAP_ERROR) 
+    {
+      /* Give back the part of the block we don't need. */
+      range_free (pool, page_idx + page_cnt, ((size_t) 1 << order) - page_cnt);
+      bitmap_set_multiple (pool->used_map, page_idx, page_cnt, true);
+    }
+  return page_idx;
+}
+
+/* Returns POOL's reserve of zeroed pages to its free lists, so
+   that they can be coalesced into larger blocks.  Returns true
+   if there were any such pages, false otherwise.  Interrupts
+   must be off. */
+static bool
+zero_reserve_release (struct pool *pool) 
+{
+  if (pool->zero_cnt == 0)
+    return false;
+  while (pool->zero_cnt > 0)
+    {
+      size_t page_idx = pool->zeroed[--pool->zero_cnt];
+      bitmap_reset (pool->used_map, page_idx);
+      range_free (pool, page_idx, 1);
+    }
+  return true;
+}
+
+/* Tops up POOL's reserve of zeroed pages.  Interrupts are only
+   off while a page is taken from or given back to POOL, never
+   while it is being cleared, so that we can be preempted at any
+   point without holding anything up.
+
+   Our priority alone does not keep us out of other threads' way:
+   under the MLFQS, a busy thread can sink below us even though
+   we are as nice as possible.  So before each page we sleep, a
+   tick at a time, for as long as any other thread is ready. */
+static void
+zero_reserve_fill (struct pool *pool) 
+{
+  for (;;)
+    {
+      enum intr_level old_level;
+      size_t page_idx;
+
+      while (thread_others_ready ())
+        timer_sleep (1);
+
+      old_level = intr_disable ();
+      page_idx = (pool->zero_cnt < pool->zero_max
+                  ? pool_alloc (pool, 1) : BITMAP_ERROR);
+      intr_set_level (old_level);
+      if (page_idx == BITMAP_ERROR)
+        break;
+
+      memset (pool->base + PGSIZE * page_idx, 0, PGSIZE);
+
+      old_level = intr_disable ();
+      if (pool->zero_cnt < pool->zero_max)
+        pool->zeroed[pool->zero_cnt++] = page_idx;
+      else
+        {
+          bitmap_reset (pool->used_map, page_idx);
+          range_free (pool, page_idx, 1);
+        }
+      intr_set_level (old_level);
+    }
+}
+
+/* Page-zeroing thread.  Refills the pools' reserves of zeroed
+   pages whenever one runs low, using only time that would
+   otherwise be idle.  It runs at the lowest priority, or the
+   highest nice value under the MLFQS, and zero_reserve_fill()
+   also steps aside whenever another thread is ready. */
+static void
+zero_thread (void *aux UNUSED) 
+{
+  if (thread_mlfqs)
+    thread_set_nice (NICE_MAX);
+
+  for (;;)
+    {
+      zero_pending = false;
+      zero_reserve_fill (&kernel_pool);
+      zero_reserve_fill (&user_pool);
+      sema_down (&zero_wanted);
+    }
+}
+
+/* Returns the list element threaded through the first page of
+   the free block at PAGE_IDX in POOL. */
+static struct list_elem *
+block_elem (const struct pool *pool, size_t page_idx) 
+{
+  return (struct list_elem *) (pool->base + PGSIZE * page_idx);
+}
+
+/* Returns the index in POOL of the free block whose list element
+   is E. */
+static size_t
+block_idx (const struct pool *pool, const struct list_elem *e) 
+{
+  return ((const uint8_t *) e - pool->base) / PGSIZE;
+}
+
+/* Removes a free block of 2**ORDER pages from POOL, splitting a
+   larger block if there is none of exactly that size, and returns
+   the index of its first page.  Returns BITMAP_ERROR if there is
+   no large enough free block.  Interrupts must be off. */
+static size_t
+block_alloc (struct pool *pool, int order) 
+{
+  size_t page_idx;
+  int k;
+
+  for (k = order; k < ORDER_CNT; k++)
+    if (!list_empty (&pool->free_lists[k]))
+      break;
+  if (k == ORDER_CNT)
+    return BITMAP_ERROR;
+
+  page_idx = block_idx (pool, list_pop_front (&pool->free_lists[k]));
+  pool->orders[page_idx] = 0;
+
+  /* Split off and free the upper half until the block is the
+     requested size. */
+  while (k > order)
+    {
+      size_t buddy;
+
+      k--;
+      buddy = page_idx + ((size_t) 1 << k);
+      pool->orders[buddy] = k + 1;
+      list_push_front (&pool->free_lists[k], block_elem (pool, buddy));
+    }
+  return page_idx;
+}
+
+/* Frees the block of 2**ORDER pages at PAGE_IDX in POOL, merging
+   it with its buddy for as long as the buddy is free too.
+   Interrupts must be off. */
+static void
+block_free (struct pool *pool, size_t page_idx, int order) 
+{
+  ASSERT (page_idx % ((size_t) 1 << order) == 0);
+
+  for (; order + 1 < ORDER_CNT; order++)
+    {
+      size_t buddy = page_idx ^ ((size_t) 1 << order);
+      if (buddy + ((size_t) 1 << order) > pool->page_cnt
+          || pool->orders[buddy] != order + 1)
+        break;
+
+      list_remove (block_elem (pool, buddy));
+      pool->orders[buddy] = 0;
+      if (buddy < page_idx)
+        page_idx = buddy;
+    }
+  pool->orders[page_idx] = order + 1;
+  list_push_front (&pool->free_lists[order], block_elem (pool, page_idx));
+}
+
+/* Frees the PAGE_CNT pages starting at PAGE_IDX in POOL, which
+   need not form a single buddy block, by freeing the largest
+   aligned blocks that they can be cut into.  Interrupts must be
+   off, except during initialization. */
+static void
+range_free (struct pool *pool, size_t page_idx, size_t page_cnt) 
+{
+  while (page_cnt > 0)
+    {
+      int order = 0;
+      while (order + 1 < ORDER_CNT
+             && page_idx % ((size_t) 2 << order) == 0
+             && ((size_t) 2 << order) <= page_cnt)
+        order++;
+
+      block_free (pool, page_idx, order);
+      page_idx += (size_t) 1 << order;
+      page_cnt -= (size_t) 1 << order;
+    }
+}
+
+/* Returns the smallest order whose blocks hold PAGE_CNT pages,
+   or ORDER_CNT if PAGE_CNT is too large for any block. */
+static int
+order_for (size_t page_cnt) 
+{
+  int order = 0;
+
+  while (order < ORDER_CNT && ((size_t) 1 << order) < page_cnt)
+    order++;
+  return order;
+}
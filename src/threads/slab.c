@@ -0,0 +1,235 @@
+#include "threads/slab.h"
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* Object caches.
+
+   A kmem_cache hands out objects of a single type and size.  It
+   carves each page it gets from the page allocator, called a
+   "slab", into as many objects as fit after a small header, and
+   keeps track of the slabs that still have free objects.  Unlike
+   malloc(), which rounds every request up to a power of 2, a
+   cache wastes at most the tail of each page, and it aligns
+   each object to a cache line (or, for small objects, to their
+   size rounded up to a power of 2) so that no object straddles
+   two lines.
+
+   A cache may have a constructor, which initializes each object
+   once when its slab is created.  Objects are then expected to
+   be returned to the cache in their constructed state, so that
+   the constructor's work need not be repeated on every
+   allocation.  For the same reason, the free objects in a slab
+   are tracked by a stack of indexes in the slab header rather
+   than by links stored in the objects themselves.
+
+   A slab whose objects are all free is kept around for reuse,
+   but only one per cache; any others are given back to the page
+   allocator. */
+
+/* Alignment for objects of at least this size. */
+#define CACHE_LINE 64
+
+/* Magic number for detecting slab corruption. */
+#define SLAB_MAGIC 0x51ab51ab
+
+/* Slab header, at the start of each slab's page. */
+struct slab
+  {
+    unsigned magic;             /* Always set to SLAB_MAGIC. */
+    struct kmem_cache *cache;   /* Owning cache. */
+    struct list_elem elem;      /* Element in cache's `partial'. */
+    size_t free_cnt;            /* Number of free objects. */
+    uint16_t free[];            /* Indexes of free objects. */
+  };
+
+/* All caches, for kmem_cache_print_stats(). */
+static struct kmem_cache *all_caches;
+
+static struct slab *slab_create (struct kmem_cache *);
+static void *slab_object (struct kmem_cache *, struct slab *, size_t idx);
+static struct slab *object_to_slab (struct kmem_cache *, void *obj);
+
+/* Initializes CACHE to hand out objects of SIZE bytes, which are
+   initialized by CTOR, if it is nonnull, when they are first
+   created.  NAME identifies the cache in statistics and must
+   remain valid for as long as the kernel runs. */
+void
+kmem_cache_init (struct kmem_cache *cache, const char *name, size_t size,
+                 kmem_ctor_func *ctor) 
+{
+  size_t align, n;
+  enum intr_level old_level;
+
+  ASSERT (cache != NULL);
+  ASSERT (size > 0);
+
+  /* Pick the alignment, and the largest number of objects that
+     fit in a page after the header and its index stack. */
+  for (align = sizeof (void *); align < size && align < CACHE_LINE; )
+    align *= 2;
+  cache->obj_size = ROUND_UP (size, align);
+  n = (PGSIZE - sizeof (struct slab)) / (cache->obj_size + sizeof (uint16_t));
+  while (n > 0 && (ROUND_UP (sizeof (struct slab) + n * sizeof (uint16_t),
+                             align)
+                   + n * cache->obj_size) > PGSIZE)
+    n--;
+  ASSERT (n > 0);
+
+  cache->name = name;
+  cache->objs_per_slab = n;
+  cache->obj_ofs = ROUND_UP (sizeof (struct slab) + n * sizeof (uint16_t),
+                             align);
+  cache->ctor = ctor;
+  lock_init_named (&cache->lock, name);
+  list_init (&cache->partial);
+  cache->empty = NULL;
+  cache->alloc_cnt = cache->free_cnt = 0;
+  cache->active_cnt = cache->slab_cnt = 0;
+
+  old_level = intr_disable ();
+  cache->next = all_caches;
+  all_caches = cache;
+  intr_set_level (old_level);
+}
+
+/* Obtains and returns a constructed object from CACHE.  Returns
+   a null pointer if memory is not available. */
+void *
+kmem_cache_alloc (struct kmem_cache *cache) 
+{
+  struct slab *s;
+  void *obj;
+
+  ASSERT (cache != NULL);
+
+  lock_acquire (&cache->lock);
+  if (!list_empty (&cache->partial))
+    s = list_entry (list_front (&cache->partial), struct slab, elem);
+  else 
+    {
+      s = cache->empty != NULL ? cache->empty : slab_create (cache);
+      if (s == NULL) 
+        {
+          lock_release (&cache->lock);
+          return NULL;
+        }
+      cache->empty = NULL;
+      list_push_front (&cache->partial, &s->elem);
+    }
+
+  obj = slab_object (cache, s, s->free[--s->free_cnt]);
+  if (s->free_cnt == 0)
+    list_remove (&s->elem);
+  cache->alloc_cnt++;
+  cache->active_cnt++;
+  lock_release (&cache->lock);
+
+  return obj;
+}
+
+/* Returns OBJ, which must have been obtained from CACHE with
+   kmem_cache_alloc(), to CACHE.  OBJ should be in the state that
+   CACHE's constructor leaves it in. */
+void
+kmem_cache_free (struct kmem_cache *cache, void *obj) 
+{
+  struct slab *s;
+
+  ASSERT (cache != NULL);
+  if (obj == NULL)
+    return;
+
+  s = object_to_slab (cache, obj);
+
+  lock_acquire (&cache->lock);
+  ASSERT (s->free_cnt < cache->objs_per_slab);
+  s->free[s->free_cnt++] = ((uint8_t *) obj - ((uint8_t *) s + cache->obj_ofs))
+                           / cache->obj_size;
+  if (s->free_cnt == 1)
+    list_push_front (&cache->partial, &s->elem);
+  if (s->free_cnt == cache->objs_per_slab) 
+    {
+      list_remove (&s->elem);
+      if (cache->empty == NULL)
+        cache->empty = s;
+      else 
+        {
+          palloc_free_page (s);
+          cache->slab_cnt--;
+        }
+    }
+  cache->free_cnt++;
+  cache->active_cnt--;
+  lock_release (&cache->lock);
+}
+
+/* Prints statistics for each cache. */
+void
+kmem_cache_print_stats (void) 
+{
+  struct kmem_cache *c;
+
+  for (c = all_caches; c != NULL; c = c->next)
+    printf ("Cache %s: %zu objects of %zu bytes in use in %zu slabs, "
+            "%llu allocations, %llu frees\n",
+            c->name, c->active_cnt, c->obj_size, c->slab_cnt,
+            c->alloc_cnt, c->free_cnt);
+}
+
+/* Allocates a new slab for CACHE and constructs its objects.
+   Returns the slab, or a null pointer if memory is not
+   available.  CACHE's lock must be held. */
+static struct slab *
+slab_create (struct kmem_cache *cache) 
+{
+  struct slab *s;
+  size_t i;
+
+  s = palloc_get_page (0);
+  if (s == NULL)
+    return NULL;
+
+  s->magic = SLAB_MAGIC;
+  s->cache = cache;
+  s->free_cnt = cache->objs_per_slab;
+  for (i = 0; i < cache->objs_per_slab; i++) 
+    {
+      /* Push in reverse so that objects are handed out in
+         address order. */
+      s->free[i] = cache->objs_per_slab - 1 - i;
+      if (cache->ctor != NULL)
+        cache->ctor (slab_object (cache, s, i));
+    }
+  cache->slab_cnt++;
+  return s;
+}
+
+/* Returns the object with index IDX in slab S of CACHE. */
+static void *
+slab_object (struct kmem_cache *cache, struct slab *s, size_t idx) 
+{
+  ASSERT (idx < cache->objs_per_slab);
+  return (uint8_t *) s + cache->obj_ofs + idx * cache->obj_size;
+}
+
+/* Returns the slab of CACHE that OBJ is inside. */
+static struct slab *
+object_to_slab (struct kmem_cache *cache, void *obj) 
+{
+  struct slab *s = pg_round_down (obj);
+
+  /* Check that the slab is valid. */
+  ASSERT (s->magic == SLAB_MAGIC);
+  ASSERT (s->cache == cache);
+
+  /* Check that the object is properly aligned for the slab. */
+  ASSERT (pg_ofs (obj) >= cache->obj_ofs);
+  ASSERT ((pg_ofs (obj) - cache->obj_ofs) % cache->obj_size == 0);
+
+  return s;
+}
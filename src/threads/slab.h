@@ -0,0 +1,39 @@
+#ifndef THREADS_SLAB_H
+#define THREADS_SLAB_H
+
+#include <list.h>
+#include <stddef.h>
+#include "threads/synch.h"
+
+/* Constructor for the objects in a kmem_cache.  Called once for
+   each object when the slab holding it is created, not on every
+   allocation. */
+typedef void kmem_ctor_func (void *obj);
+
+/* A cache of fixed-size objects of one type.  See slab.c. */
+struct kmem_cache
+  {
+    const char *name;           /* Name, for statistics. */
+    size_t obj_size;            /* Object size, rounded up to align. */
+    size_t objs_per_slab;       /* Number of objects in a slab. */
+    size_t obj_ofs;             /* Offset of first object in a slab. */
+    kmem_ctor_func *ctor;       /* Constructor, or null. */
+    struct lock lock;           /* Protects the fields below. */
+    struct list partial;        /* Slabs with some objects free. */
+    struct slab *empty;         /* A slab with all objects free, or null. */
+    struct kmem_cache *next;    /* Next cache, for statistics. */
+
+    /* Statistics. */
+    unsigned long long alloc_cnt; /* Number of allocations. */
+    unsigned long long free_cnt; /* Number of frees. */
+    size_t active_cnt;          /* Objects currently allocated. */
+    size_t slab_cnt;            /* Slabs currently allocated. */
+  };
+
+void kmem_cache_init (struct kmem_cache *, const char *name, size_t size,
+                      kmem_ctor_func *);
+void *kmem_cache_alloc (struct kmem_cache *);
+void kmem_cache_free (struct kmem_cache *, void *);
+void kmem_cache_print_stats (void);
+
+#endif /* threads/slab.h */
@@ -28,11 +28,44 @@
 #include <string.h>
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "devices/timer.h"
+
+/* Lock contention statistics.
+
+   When the kernel is built with -DLOCKSTAT (for example, with
+   "make DEFINES=-DLOCKSTAT"), every lock given a name by
+   lock_init_named() counts its acquisitions, how many of them
+   had to wait, and how long they waited and held the lock, in
+   timer ticks.  Locks that share a name, such as the
+   per-size-class malloc locks, share one set of statistics.
+   lock_print_stats() prints them at shutdown. */
+#ifdef LOCKSTAT
+struct lock_stats
+  {
+    const char *name;           /* Lock name. */
+    unsigned long long acquired; /* Number of acquisitions. */
+    unsigned long long contended; /* Acquisitions that had to wait. */
+    int64_t wait_ticks;         /* Total ticks spent waiting. */
+    int64_t max_wait_ticks;     /* Longest single wait. */
+    int64_t hold_ticks;         /* Total ticks held. */
+    int64_t max_hold_ticks;     /* Longest single hold. */
+  };
+
+/* Statistics for each distinct lock name. */
+#define LOCKSTAT_MAX 64
+static struct lock_stats lock_stats[LOCKSTAT_MAX];
+static size_t lock_stats_cnt;
 
-bool thread_priority_compare2(const struct list_elem* a, const struct list_elem* b, void* aux UNUSED);
-static bool lock_priority_compare(const struct list_elem* a, const struct list_elem* b, void* aux UNUSED);
-static bool cond_priority_compare(const struct list_elem* a, const struct list_elem* b, void* aux UNUSED);
-void priority_back(struct lock *lock);
+static struct lock_stats *lock_stats_lookup (const char *name);
+static void lockstat_acquired (struct lock *, bool contended,
+                               int64_t wait_start);
+static void lockstat_released (struct lock *);
+#endif
+
+static bool sema_waiter_less (const struct heap_elem *a, const struct heap_elem *b, void *aux UNUSED);
+static bool cond_waiter_less (const struct heap_elem *a, const struct heap_elem *b, void *aux UNUSED);
+static void donate_priority (struct lock *, int priority);
+static void lock_take (struct lock *, struct thread *);
 
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
@@ -47,7 +80,7 @@ sema_init (struct semaphore *sema, unsigned value)
   ASSERT (sema != NULL);
 
   sema->value = value;
-  list_init (&sema->waiters);
+  heap_init (&sema->waiters, sema_waiter_less, NULL);
 }
 
 /* Down or "P" operation on a semaphore.  Waits for SEMA's value
@@ -68,7 +101,17 @@ sema_down (struct semaphore *sema)
   old_level = intr_disable ();
   while (sema->value == 0) 
     {
-      list_insert_ordered(&sema->waiters, &thread_current()->elem, thread_priority_compare2, NULL);
+      struct thread *curr = thread_current ();
+
+      heap_push (&sema->waiters, &curr->wait_elem);
+
+      /* Let donation re-key us in the wait queue, unless
+         cond_wait() already registered its own queue. */
+      if (curr->waiting_on == NULL)
+        {
+          curr->waiting_on = &sema->waiters;
+          curr->waiting_elem = &curr->wait_elem;
+        }
       thread_block ();
     }
   sema->value--;
@@ -101,28 +144,38 @@ sema_try_down (struct semaphore *sema)
 }
 
 /* Up or "V" operation on a semaphore.  Increments SEMA's value
-   and wakes up one thread of those waiting for SEMA, if any.
+   and wakes up the highest-priority thread of those waiting for
+   SEMA, if any, yielding the CPU to it if it outranks the running
+   thread.
    This function may be called from an interrupt handler. */
 void
 sema_up (struct semaphore *sema) 
 {
   enum intr_level old_level;
+  bool preempt = false;
+
   ASSERT (sema != NULL);
+
   old_level = intr_disable ();
-  if (!list_empty (&sema->waiters))
-  { 
-    list_sort(&sema->waiters,thread_priority_compare2 , NULL);
-    struct thread *a_thread = list_entry (list_pop_front (&sema->waiters), struct thread, elem);
-    thread_unblock(a_thread);
-    sema->value++;
-    intr_set_level (old_level);
-    thread_yield();
-  }
-  else
-  {
-    sema->value++;
-    intr_set_level (old_level);
-  }
+  sema->value++;
+  if (!heap_empty (&sema->waiters))
+    {
+      struct thread *t = heap_entry (heap_pop (&sema->waiters),
+                                     struct thread, wait_elem);
+      if (t->waiting_on == &sema->waiters)
+        t->waiting_on = NULL;
+      thread_unblock (t);
+      preempt = t->priority > thread_current ()->priority;
+    }
+  intr_set_level (old_level);
+
+  if (preempt)
+    {
+      if (intr_context ())
+        intr_yield_on_return ();
+      else
+        thread_yield ();
+    }
 }
 
 static void sema_test_helper (void *sema_);
@@ -178,11 +231,27 @@ sema_test_helper (void *sema_)
    instead of a lock. */
 void
 lock_init (struct lock *lock)
+{
+  lock_init_named (lock, NULL);
+}
+
+/* Initializes LOCK, like lock_init(), and files its contention
+   statistics under NAME, which must remain valid for as long as
+   the kernel runs.  NAME may be null, in which case nothing is
+   recorded.  NAME is ignored unless the kernel is built with
+   LOCKSTAT defined. */
+void
+lock_init_named (struct lock *lock, const char *name UNUSED)
 {
   ASSERT (lock != NULL);
 
   lock->holder = NULL;
   sema_init (&lock->semaphore, 1);
+  lock->priority = PRI_MIN - 1;
+#ifdef LOCKSTAT
+  lock->stats = name != NULL ? lock_stats_lookup (name) : NULL;
+  lock->hold_start = 0;
+#endif
 }
 
 /* Acquires LOCK, sleeping until it becomes available if
@@ -196,33 +265,36 @@ void
 lock_acquire (struct lock *lock)
 {
   struct thread *curr = thread_current();
-  struct lock *l = lock;
+  enum intr_level old_level;
+  bool contended;
+#ifdef LOCKSTAT
+  int64_t wait_start = timer_ticks ();
+#endif
+
   ASSERT (lock != NULL);
   ASSERT (!intr_context ());
   ASSERT (!lock_held_by_current_thread (lock));
-  curr->lock_held = lock;
-
-  /*solving nested priority donation*/
 
-  while(l->holder != NULL && curr->priority > l->holder->priority)
-  {
-    l->holder->priority = curr->priority;
-    l->holder->donation ++;
-    if(l->holder->lock_held == NULL)
-    {
-      break;
-    }
-    else
+  old_level = intr_disable ();
+  contended = lock->holder != NULL;
+  if (contended)
     {
-      l = l -> holder -> lock_held;
+      /* Donate our priority down the chain of holders before
+         going to sleep.  The 4.4BSD scheduler does not donate
+         priority. */
+      curr->waiting_lock = lock;
+      if (!thread_mlfqs)
+        donate_priority (lock, curr->priority);
     }
-  }
 
   sema_down (&lock->semaphore);
 
-  lock->holder = curr;
-  curr->lock_held = NULL;
-  list_insert_ordered(&thread_current()->key, &lock->elem, lock_priority_compare, NULL);
+  curr->waiting_lock = NULL;
+  lock_take (lock, curr);
+#ifdef LOCKSTAT
+  lockstat_acquired (lock, contended, wait_start);
+#endif
+  intr_set_level (old_level);
 }
 
 /* Tries to acquires LOCK and returns true if successful or false
@@ -233,14 +305,22 @@ lock_acquire (struct lock *lock)
 bool
 lock_try_acquire (struct lock *lock)
 {
+  enum intr_level old_level;
   bool success;
 
   ASSERT (lock != NULL);
   ASSERT (!lock_held_by_current_thread (lock));
 
+  old_level = intr_disable ();
   success = sema_try_down (&lock->semaphore);
   if (success)
-    lock->holder = thread_current ();
+    {
+      lock_take (lock, thread_current ());
+#ifdef LOCKSTAT
+      lockstat_acquired (lock, false, timer_ticks ());
+#endif
+    }
+  intr_set_level (old_level);
   return success;
 }
 
@@ -252,39 +332,72 @@ lock_try_acquire (struct lock *lock)
 void
 lock_release (struct lock *lock) 
 {
+  struct thread *curr = thread_current();
+  enum intr_level old_level;
+
   ASSERT (lock != NULL);
   ASSERT (lock_held_by_current_thread (lock));
-  struct list lock_waiters = (&lock->semaphore)->waiters;
-  struct thread *same_lock_next_thread = list_entry(list_front(&lock_waiters),struct thread, elem);
-  struct thread *curr = thread_current();
 
-  list_remove(&lock->elem);
+  /* Give back whatever LOCK's waiters donated to us.  Our
+     priority falls to the greater of our base priority and the
+     best donation through the locks we still hold. */
+  old_level = intr_disable ();
+#ifdef LOCKSTAT
+  lockstat_released (lock);
+#endif
+  heap_remove (&curr->held_locks, &lock->holder_elem);
+  lock->holder = NULL;
+  thread_update_priority (curr, thread_effective_priority (curr));
+  intr_set_level (old_level);
 
-  /* When the thread have donated priority, 
-  back to base priority or get other priority of lock held on thread
-  */
-  if(same_lock_next_thread->priority == curr->priority) //priority가 상속이 된 경우
-  {
-    /*
-    현재 thread가 여러 thread에 상속을 하였고, lock을 걸어놓은 것들의 리스트가 비어있지 않는 경우
-    */
-    if(curr->donation > 1 && !list_empty(&curr->key))
+  sema_up (&lock->semaphore);
+}
+
+/* Propagates a donation of PRIORITY, made by a thread that is
+   waiting for LOCK, to LOCK's holder, and from there along the
+   chain of locks that each holder is itself waiting for.  Stops
+   as soon as a lock or holder already has at least PRIORITY, so
+   each link costs constant time.  Interrupts must be off. */
+static void
+donate_priority (struct lock *lock, int priority)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  while (lock != NULL && priority > lock->priority)
     {
-      struct semaphore high_sema = list_entry(list_front(&curr->key), struct lock, elem)->semaphore;
-      struct thread *high_priority_lock_thread = list_entry(list_front(&high_sema.waiters),struct thread,elem); 
-      curr->priority = high_priority_lock_thread -> priority;
+      struct thread *holder = lock->holder;
+
+      lock->priority = priority;
+      if (holder == NULL)
+        break;
+      heap_increase (&holder->held_locks, &lock->holder_elem);
+
+      if (priority <= holder->priority)
+        break;
+      thread_update_priority (holder, priority);
+      thread_trace (TRACE_DONATE, holder, priority);
+      lock = holder->waiting_lock;
     }
-    /*
-    그냥 한번만 상속을 한 경우 
-    */
-    else
-    {
-     curr->priority = curr -> base_priority;
-    } 
-  }
+}
 
-  lock->holder = NULL;
-  sema_up (&lock->semaphore);
+/* Makes T, which has just downed LOCK's semaphore, the holder
+   of LOCK.  The threads still waiting for LOCK now donate to T.
+   Interrupts must be off. */
+static void
+lock_take (struct lock *lock, struct thread *t)
+{
+  struct heap *waiters = &lock->semaphore.waiters;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  lock->holder = t;
+  lock->priority = PRI_MIN - 1;
+  if (!heap_empty (waiters) && !thread_mlfqs)
+    lock->priority = heap_entry (heap_top (waiters),
+                                 struct thread, wait_elem)->priority;
+  heap_push (&t->held_locks, &lock->holder_elem);
+  if (lock->priority > t->priority)
+    thread_update_priority (t, lock->priority);
 }
 
 
@@ -299,13 +412,99 @@ lock_held_by_current_thread (const struct lock *lock)
   return lock->holder == thread_current ();
 }
 
-/* One semaphore in a list. */
+/* Prints contention statistics for each named lock, if the
+   kernel was built with LOCKSTAT defined. */
+void
+lock_print_stats (void) 
+{
+#ifdef LOCKSTAT
+  struct lock_stats *st;
+
+  for (st = lock_stats; st < lock_stats + lock_stats_cnt; st++)
+    printf ("Lock %s: %llu acquisitions, %llu contended, "
+            "%lld wait ticks (max %lld), %lld hold ticks (max %lld)\n",
+            st->name, st->acquired, st->contended,
+            st->wait_ticks, st->max_wait_ticks,
+            st->hold_ticks, st->max_hold_ticks);
+#endif
+}
+
+#ifdef LOCKSTAT
+/* Returns the statistics for locks named NAME, creating them if
+   this is the first such lock.  Returns a null pointer if there
+   are already too many names to track another. */
+static struct lock_stats *
+lock_stats_lookup (const char *name) 
+{
+  struct lock_stats *st;
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  for (st = lock_stats; st < lock_stats + lock_stats_cnt; st++)
+    if (!strcmp (st->name, name))
+      goto done;
+  if (lock_stats_cnt < LOCKSTAT_MAX)
+    {
+      st = &lock_stats[lock_stats_cnt++];
+      st->name = name;
+    }
+  else
+    st = NULL;
+ done:
+  intr_set_level (old_level);
+  return st;
+}
+
+/* Records that the current thread has just acquired LOCK, after
+   waiting since tick WAIT_START if CONTENDED.  Interrupts must
+   be off. */
+static void
+lockstat_acquired (struct lock *lock, bool contended, int64_t wait_start) 
+{
+  struct lock_stats *st = lock->stats;
+  int64_t now = timer_ticks ();
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  lock->hold_start = now;
+  if (st == NULL)
+    return;
+  st->acquired++;
+  if (contended)
+    {
+      int64_t wait = now - wait_start;
+      st->contended++;
+      st->wait_ticks += wait;
+      if (wait > st->max_wait_ticks)
+        st->max_wait_ticks = wait;
+    }
+}
+
+/* Records that the current thread is about to release LOCK.
+   Interrupts must be off. */
+static void
+lockstat_released (struct lock *lock) 
+{
+  struct lock_stats *st = lock->stats;
+  int64_t hold;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (st == NULL)
+    return;
+  hold = timer_ticks () - lock->hold_start;
+  st->hold_ticks += hold;
+  if (hold > st->max_hold_ticks)
+    st->max_hold_ticks = hold;
+}
+#endif /* LOCKSTAT */
+
+/* One semaphore in a condition variable's wait queue. */
 struct semaphore_elem 
   {
-    struct list_elem elem;              /* List element. */
+    struct heap_elem elem;              /* Heap element. */
     struct semaphore semaphore;         /* This semaphore. */
-
-    int priority;
+    struct thread *thread;              /* Thread waiting on it. */
   };
 
 /* Initializes condition variable COND.  A condition variable
@@ -316,7 +515,7 @@ cond_init (struct condition *cond)
 {
   ASSERT (cond != NULL);
 
-  list_init (&cond->waiters);
+  heap_init (&cond->waiters, cond_waiter_less, NULL);
 }
 
 /* Atomically releases LOCK and waits for COND to be signaled by
@@ -339,7 +538,9 @@ cond_init (struct condition *cond)
 void
 cond_wait (struct condition *cond, struct lock *lock) 
 {
+  struct thread *curr = thread_current ();
   struct semaphore_elem waiter;
+  enum intr_level old_level;
 
   ASSERT (cond != NULL);
   ASSERT (lock != NULL);
@@ -347,8 +548,16 @@ cond_wait (struct condition *cond, struct lock *lock)
   ASSERT (lock_held_by_current_thread (lock));
   
   sema_init (&waiter.semaphore, 0);
-  waiter.priority = thread_current()->priority;
-  list_insert_ordered(&cond->waiters, &waiter.elem, cond_priority_compare, NULL);
+  waiter.thread = curr;
+
+  /* Donation may re-key the wait queue from an interrupt
+     handler, so it is only touched with interrupts off. */
+  old_level = intr_disable ();
+  heap_push (&cond->waiters, &waiter.elem);
+  curr->waiting_on = &cond->waiters;
+  curr->waiting_elem = &waiter.elem;
+  intr_set_level (old_level);
+
   lock_release (lock);
   sema_down (&waiter.semaphore);
   lock_acquire (lock);
@@ -363,14 +572,25 @@ cond_wait (struct condition *cond, struct lock *lock)
 void
 cond_signal (struct condition *cond, struct lock *lock UNUSED) 
 {
+  struct semaphore_elem *waiter = NULL;
+  enum intr_level old_level;
+
   ASSERT (cond != NULL);
   ASSERT (lock != NULL);
   ASSERT (!intr_context ());
   ASSERT (lock_held_by_current_thread (lock));
 
-  if (!list_empty (&cond->waiters)) 
-    sema_up (&list_entry (list_pop_front (&cond->waiters),
-                          struct semaphore_elem, elem)->semaphore);
+  old_level = intr_disable ();
+  if (!heap_empty (&cond->waiters)) 
+    {
+      waiter = heap_entry (heap_pop (&cond->waiters),
+                           struct semaphore_elem, elem);
+      waiter->thread->waiting_on = NULL;
+    }
+  intr_set_level (old_level);
+
+  if (waiter != NULL)
+    sema_up (&waiter->semaphore);
 }
 
 /* Wakes up all threads, if any, waiting on COND (protected by
@@ -384,44 +604,144 @@ cond_broadcast (struct condition *cond, struct lock *lock)
   ASSERT (cond != NULL);
   ASSERT (lock != NULL);
 
-  while (!list_empty (&cond->waiters))
+  while (!heap_empty (&cond->waiters))
     cond_signal (cond, lock);
 }
 
+/* Initializes RW, a readers-writer lock.
+
+   The lock is built from a lock, GATE, that every thread passes
+   through on the way in: a reader holds it only long enough to
+   count itself in, but a writer keeps it until it releases RW.
+   Thus, a writer's waiters queue up on GATE in priority order
+   and donate their priority to it just as they would for an
+   ordinary lock, and once a writer has GATE no new reader can
+   get in ahead of it.  The writer then waits on DRAINED for the
+   readers already inside to leave. */
+void
+rwlock_init (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  lock_init (&rw->gate);
+  sema_init (&rw->drained, 0);
+  rw->readers = 0;
+  rw->writer_waiting = false;
+}
+
+/* Acquires RW for reading, sleeping while a writer holds it or
+   is waiting for it.  The current thread must not already hold
+   RW for writing.
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_read (struct rwlock *rw)
+{
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+
+  lock_acquire (&rw->gate);
+  old_level = intr_disable ();
+  rw->readers++;
+  intr_set_level (old_level);
+  lock_release (&rw->gate);
+}
+
+/* Releases RW, which the current thread must hold for reading.
+   The last reader out lets a waiting writer in. */
+void
+rwlock_release_read (struct rwlock *rw)
+{
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+  ASSERT (rw->readers > 0);
+
+  old_level = intr_disable ();
+  if (--rw->readers == 0 && rw->writer_waiting)
+    {
+      rw->writer_waiting = false;
+      sema_up (&rw->drained);
+    }
+  intr_set_level (old_level);
+}
+
+/* Acquires RW for writing, sleeping until no other thread holds
+   it.  The current thread must not already hold RW.
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_write (struct rwlock *rw)
+{
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+
+  lock_acquire (&rw->gate);
+
+  /* No reader can get in while we hold the gate, so once the
+     ones inside have drained out we have RW to ourselves. */
+  old_level = intr_disable ();
+  if (rw->readers > 0)
+    {
+      rw->writer_waiting = true;
+      sema_down (&rw->drained);
+    }
+  intr_set_level (old_level);
+}
+
+/* Releases RW, which the current thread must hold for writing. */
+void
+rwlock_release_write (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+  ASSERT (rwlock_held_for_write (rw));
+
+  lock_release (&rw->gate);
+}
+
+/* Returns true if the current thread holds RW for writing, false
+   otherwise.  A writer still waiting for readers to drain out
+   does not count. */
 bool
-thread_priority_compare2(const struct list_elem* a, const struct list_elem* b, void* aux UNUSED)
+rwlock_held_for_write (const struct rwlock *rw)
 {
-  const struct thread* th_a = list_entry(a, struct thread, elem);
-  const struct thread* th_b = list_entry(b, struct thread, elem);
-  return th_a->priority > th_b->priority;
+  ASSERT (rw != NULL);
+
+  return lock_held_by_current_thread (&rw->gate) && !rw->writer_waiting;
 }
 
+/* Orders threads in a semaphore's wait queue by priority. */
 static bool
-lock_priority_compare(const struct list_elem* a, const struct list_elem* b, void* aux UNUSED)
+sema_waiter_less (const struct heap_elem *a, const struct heap_elem *b,
+                  void *aux UNUSED)
 {
-  struct lock* a_lock = list_entry(a, struct lock, elem);
-  struct lock* b_lock = list_entry(b, struct lock, elem);
+  const struct thread *th_a = heap_entry (a, struct thread, wait_elem);
+  const struct thread *th_b = heap_entry (b, struct thread, wait_elem);
+  return th_a->priority < th_b->priority;
+}
 
-  if(list_empty(&a_lock->semaphore.waiters))
-  {
-    return true;
-  }
-  else if(list_empty(&b_lock->semaphore.waiters))
-  {
-    return false;
-  }
-  else
-  {
-    const struct thread* a_thread = list_entry(list_front(&a_lock->semaphore.waiters), struct thread, elem);
-    const struct thread* b_thread = list_entry(list_front(&b_lock->semaphore.waiters), struct thread, elem);
-    return a_thread->priority > b_thread->priority;
-  }
+/* Orders locks by the priority they donate to their holder, that
+   is, by the priority of their highest-priority waiter. */
+bool
+lock_priority_less (const struct heap_elem *a, const struct heap_elem *b,
+                    void *aux UNUSED)
+{
+  const struct lock *a_lock = heap_entry (a, struct lock, holder_elem);
+  const struct lock *b_lock = heap_entry (b, struct lock, holder_elem);
+  return a_lock->priority < b_lock->priority;
 }
 
+/* Orders a condition variable's waiters by the priority of the
+   thread waiting on each one. */
 static bool
-cond_priority_compare(const struct list_elem* a, const struct list_elem* b, void* aux UNUSED)
+cond_waiter_less (const struct heap_elem *a, const struct heap_elem *b,
+                  void *aux UNUSED)
 {
-  struct semaphore_elem *sema_a = list_entry(a,struct semaphore_elem,elem);
-  struct semaphore_elem *sema_b = list_entry(b,struct semaphore_elem,elem);  
-  return sema_a -> priority > sema_b -> priority;
+  const struct semaphore_elem *sema_a = heap_entry (a, struct semaphore_elem, elem);
+  const struct semaphore_elem *sema_b = heap_entry (b, struct semaphore_elem, elem);
+  return sema_a->thread->priority < sema_b->thread->priority;
 }
\ No newline at end of file
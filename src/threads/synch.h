@@ -1,14 +1,16 @@
 #ifndef THREADS_SYNCH_H
 #define THREADS_SYNCH_H
 
+#include <heap.h>
 #include <list.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 /* A counting semaphore. */
 struct semaphore 
   {
     unsigned value;             /* Current value. */
-    struct list waiters;        /* List of waiting threads. */
+    struct heap waiters;        /* Waiting threads, by priority. */
   };
 
 void sema_init (struct semaphore *, unsigned value);
@@ -23,19 +25,27 @@ struct lock
     struct thread *holder;      /* Thread holding lock (for debugging). */
     struct semaphore semaphore; /* Binary semaphore controlling access. */
 
-    struct list_elem elem;      /* List element */
+    int priority;               /* Highest waiter priority, or PRI_MIN - 1. */
+    struct heap_elem holder_elem; /* Element in holder's `held_locks'. */
+
+#ifdef LOCKSTAT
+    struct lock_stats *stats;   /* Statistics for LOCK's name, or null. */
+    int64_t hold_start;         /* Tick at which holder acquired LOCK. */
+#endif
   };
 
 void lock_init (struct lock *);
+void lock_init_named (struct lock *, const char *name);
 void lock_acquire (struct lock *);
 bool lock_try_acquire (struct lock *);
 void lock_release (struct lock *);
 bool lock_held_by_current_thread (const struct lock *);
+void lock_print_stats (void);
 
 /* Condition variable. */
 struct condition 
   {
-    struct list waiters;        /* List of waiting threads. */
+    struct heap waiters;        /* Waiting semaphore_elems, by priority. */
   };
 
 void cond_init (struct condition *);
@@ -43,7 +53,27 @@ void cond_wait (struct condition *, struct lock *);
 void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
 
-void priority_donation(struct lock *lock);
+/* Readers-writer lock.  Any number of readers may hold it at
+   once, or a single writer.  A writer that is waiting keeps new
+   readers out, and threads blocked behind a writer donate their
+   priority to it. */
+struct rwlock
+  {
+    struct lock gate;           /* Held by the writer; briefly by readers. */
+    struct semaphore drained;   /* Upped when the last reader leaves. */
+    unsigned readers;           /* Number of readers holding the lock. */
+    bool writer_waiting;        /* Gate holder is waiting on `drained'. */
+  };
+
+void rwlock_init (struct rwlock *);
+void rwlock_acquire_read (struct rwlock *);
+void rwlock_release_read (struct rwlock *);
+void rwlock_acquire_write (struct rwlock *);
+void rwlock_release_write (struct rwlock *);
+bool rwlock_held_for_write (const struct rwlock *);
+
+/* Orders locks by the priority they donate to their holder. */
+heap_less_func lock_priority_less;
 
 /* Optimization barrier.
    The compiler will not reorder operations across an
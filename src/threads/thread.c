@@ -1,16 +1,22 @@
 #include "threads/thread.h"
 #include <debug.h>
+#include <hash.h>
+#include <stdarg.h>
 #include <stddef.h>
 #include <random.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/cpu.h"
 #include "threads/flags.h"
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/switch.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
+#include "devices/serial.h"
+#include "devices/timer.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #endif
@@ -24,19 +30,17 @@
    Do not modify this value. */
 #define THREAD_BASIC 0xd42df210
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
-
-/* Idle thread. */
-static struct thread *idle_thread;
-
 /* Initial thread, the thread running init.c:main(). */
 static struct thread *initial_thread;
 
 /* Lock used by allocate_tid(). */
 static struct lock tid_lock;
 
+/* Every live thread, keyed by tid, for get_thread().  Created by
+   thread_start() once malloc() is available. */
+static struct hash tid_table;
+static struct lock tid_table_lock;
+
 static struct list file_list;
 
 /* Stack frame for kernel_thread(). */
@@ -61,6 +65,31 @@ static unsigned thread_ticks;   /* # of timer ticks since last yield. */
    Controlled by kernel command-line option "-o mlfqs". */
 bool thread_mlfqs;
 
+/* If true, record scheduler events for thread_trace_dump().
+   Controlled by kernel command-line option "-trace". */
+bool thread_trace_enabled;
+
+/* One recorded scheduler event. */
+struct trace_entry
+  {
+    uint64_t tsc;               /* CPU cycle counter. */
+    int64_t tick;               /* Timer tick. */
+    tid_t tid;                  /* Thread the event concerns. */
+    int arg;                    /* Event-specific argument. */
+    uint8_t event;              /* An enum trace_event. */
+    uint8_t cpu;                /* CPU the thread is assigned to. */
+  };
+
+/* Ring of the most recent TRACE_CNT scheduler events.
+   TRACE_CNT must be a power of 2. */
+#define TRACE_CNT 1024
+static struct trace_entry trace_ring[TRACE_CNT];
+static unsigned trace_head;     /* Number of events ever recorded. */
+
+/* System load average, for the multi-level feedback queue
+   scheduler. */
+static fixed_t load_avg;
+
 static void kernel_thread (thread_func *, void *aux);
 
 static void idle (void *aux UNUSED);
@@ -72,28 +101,40 @@ static void *alloc_frame (struct thread *, size_t size);
 static void schedule (void);
 void schedule_tail (struct thread *prev);
 static tid_t allocate_tid (void);
-
-static bool thread_priority_compare1(const struct list_elem* a, const struct list_elem* b, void* aux UNUSED);
+static void tid_table_insert (struct thread *);
+static void tid_table_remove (struct thread *);
+static hash_hash_func tid_hash;
+static hash_less_func tid_less;
+
+static void ready_queue_init (struct ready_queue *);
+static void ready_queue_push (struct cpu *, struct thread *);
+static void ready_queue_remove (struct cpu *, struct thread *);
+static struct thread *ready_queue_pop (struct cpu *);
+static int ready_queue_max (const struct ready_queue *);
+static bool is_idle_thread (const struct thread *);
+static void mlfqs_update_load_avg (void);
+static void mlfqs_update_recent_cpu (struct thread *);
+static void mlfqs_update_priority (struct thread *);
+static void trace_printf (const char *, ...) PRINTF_FORMAT (1, 2);
 void thread_preemption (int priority);
 
 static struct list all_thread;
 
 
+/* Returns the live thread whose tid is TID, or a null pointer if
+   there is none. */
 struct thread *
 get_thread(int tid)
 {
-  struct thread * result;
-  struct list_elem * e;
+  struct thread key;
+  struct hash_elem *e;
 
-  for(e=list_begin(&all_thread);e!=list_end(&all_thread);e=list_next(e))
-  {
-    result = list_entry(e,struct thread,all_elem);
-    if(result->tid == tid)
-    {
-      return result;
-    }
-  }
-  return NULL;
+  key.tid = tid;
+  lock_acquire (&tid_table_lock);
+  e = hash_find (&tid_table, &key.tid_elem);
+  lock_release (&tid_table_lock);
+
+  return e != NULL ? hash_entry (e, struct thread, tid_elem) : NULL;
 }
 
 
@@ -102,7 +143,8 @@ get_thread(int tid)
    that's currently running into a thread.  This can't work in
    general and it is possible in this case only because loader.S
    was careful to put the bottom of the stack at a page boundary.
-   Also initializes the run queue and the tid lock.
+   Also initializes the bootstrap CPU's run queue and the tid
+   lock.
    After calling this function, be sure to initialize the page
    allocator before trying to create any threads with
    thread_create().
@@ -113,8 +155,10 @@ thread_init (void)
 {
   ASSERT (intr_get_level () == INTR_OFF);
 
-  lock_init (&tid_lock);
-  list_init (&ready_list);
+  lock_init_named (&tid_lock, "tid");
+  lock_init_named (&tid_table_lock, "tid table");
+  cpu_init ();
+  ready_queue_init (&cpus[0].rq);
   list_init(&all_thread);
 
   /* Set up a thread structure for the running thread. */
@@ -131,13 +175,20 @@ thread_start (void)
 {
   /* Create the idle thread. */
   struct semaphore idle_started;
+
+  /* Now that malloc() works, index the initial thread by tid. */
+  if (!hash_init (&tid_table, tid_hash, tid_less, NULL))
+    PANIC ("thread_start: cannot allocate tid table");
+  tid_table_insert (initial_thread);
+
   sema_init (&idle_started, 0);
   thread_create ("idle", PRI_MIN, idle, &idle_started);
 
   /* Start preemptive thread scheduling. */
   intr_enable ();
 
-  /* Wait for the idle thread to initialize idle_thread. */
+  /* Wait for the idle thread to initialize the CPU's
+     idle_thread. */
   sema_down (&idle_started);
 }
 
@@ -147,9 +198,10 @@ void
 thread_tick (void) 
 {
   struct thread *t = thread_current ();
+  struct cpu *c = cpu_current ();
 
   /* Update statistics. */
-  if (t == idle_thread)
+  if (t == c->idle_thread)
     idle_ticks++;
 #ifdef USERPROG
   else if (t->pagedir != NULL)
@@ -158,6 +210,43 @@ thread_tick (void)
   else
     kernel_ticks++;
 
+  /* Only the running thread's recent_cpu changes from tick to
+     tick, so only threads that have run since the last 4-tick
+     boundary need their priorities recomputed at the next one.
+     The running thread is recomputed here, and schedule()
+     recomputes each thread as it gives up the CPU, so none is
+     left stale.  Everyone is recomputed once per second, when
+     load_avg decays every thread's recent_cpu. */
+  if (thread_mlfqs)
+    {
+      int64_t now = timer_ticks ();
+
+      if (t != c->idle_thread)
+        t->recent_cpu = fp_add_int (t->recent_cpu, 1);
+
+      if (now % TIMER_FREQ == 0)
+        {
+          struct list_elem *e;
+
+          mlfqs_update_load_avg ();
+          for (e = list_begin (&all_thread); e != list_end (&all_thread);
+               e = list_next (e))
+            {
+              struct thread *th = list_entry (e, struct thread, all_elem);
+              if (!is_idle_thread (th))
+                {
+                  mlfqs_update_recent_cpu (th);
+                  mlfqs_update_priority (th);
+                }
+            }
+        }
+      else if (now % 4 == 0 && t != c->idle_thread)
+        mlfqs_update_priority (t);
+
+      if (ready_queue_max (&c->rq) > t->priority)
+        intr_yield_on_return ();
+    }
+
   /* Enforce preemption. */
   if (++thread_ticks >= TIME_SLICE)
     intr_yield_on_return ();
@@ -171,6 +260,94 @@ thread_print_stats (void)
           idle_ticks, kernel_ticks, user_ticks);
 }
 
+/* Returns the CPU's time-stamp counter. */
+static inline uint64_t
+rdtsc (void) 
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* Records EVENT, concerning thread T, with argument ARG in the
+   trace ring, if tracing is enabled.  May be called from an
+   interrupt handler. */
+void
+thread_trace (enum trace_event event, const struct thread *t, int arg) 
+{
+  struct trace_entry *e;
+  enum intr_level old_level;
+
+  if (!thread_trace_enabled)
+    return;
+
+  old_level = intr_disable ();
+  e = &trace_ring[trace_head++ % TRACE_CNT];
+  e->tsc = rdtsc ();
+  e->tick = timer_ticks ();
+  e->tid = t->tid;
+  e->arg = arg;
+  e->event = event;
+  e->cpu = t->cpu;
+  intr_set_level (old_level);
+}
+
+/* Writes the trace ring to the serial port, oldest event first,
+   followed by the names of the threads still alive, in the form
+   read by utils/pintos-trace.  Only the first call does
+   anything, so that a panic during shutdown does not dump the
+   ring twice. */
+void
+thread_trace_dump (void) 
+{
+  static const char *names[] = {"switch", "block", "unblock",
+                                "donate", "wakeup"};
+  static bool dumped;
+  enum intr_level old_level;
+  struct list_elem *e;
+  unsigned i;
+
+  if (!thread_trace_enabled || dumped)
+    return;
+  dumped = true;
+
+  old_level = intr_disable ();
+  i = trace_head > TRACE_CNT ? trace_head - TRACE_CNT : 0;
+  trace_printf ("TRACE-BEGIN %u %u\n", trace_head - i, i);
+  for (; i != trace_head; i++)
+    {
+      const struct trace_entry *te = &trace_ring[i % TRACE_CNT];
+      trace_printf ("TRACE %u %lld %llu %s %d %d %d\n",
+                    i, te->tick, te->tsc, names[te->event], te->cpu,
+                    te->tid, te->arg);
+    }
+  for (e = list_begin (&all_thread); e != list_end (&all_thread);
+       e = list_next (e))
+    {
+      struct thread *t = list_entry (e, struct thread, all_elem);
+      trace_printf ("TRACE-THREAD %d %s\n", t->tid, t->name);
+    }
+  trace_printf ("TRACE-END\n");
+  intr_set_level (old_level);
+}
+
+/* Formats a line of trace output and writes it to the serial
+   port only, bypassing the console. */
+static void
+trace_printf (const char *format, ...) 
+{
+  char buf[96];
+  const char *p;
+  va_list args;
+
+  va_start (args, format);
+  vsnprintf (buf, sizeof buf, format, args);
+  va_end (args);
+
+  for (p = buf; *p != '\0'; p++)
+    serial_putc (*p);
+}
+
 /* Creates a new kernel thread named NAME with the given initial
    PRIORITY, which executes FUNCTION passing AUX as the argument,
    and adds it to the ready queue.  Returns the thread identifier
@@ -192,6 +369,7 @@ thread_create (const char *name, int priority,
   struct kernel_thread_frame *kf;
   struct switch_entry_frame *ef;
   struct switch_threads_frame *sf;
+  enum intr_level old_level;
   tid_t tid;
 
   ASSERT (function != NULL);
@@ -201,9 +379,15 @@ thread_create (const char *name, int priority,
   if (t == NULL)
     return TID_ERROR;
 
-  /* Initialize thread. */
+  /* Initialize thread.  Under the MLFQS, init_thread() computes
+     the priority itself and PRIORITY is ignored. */
   init_thread (t, name, priority);
+  priority = t->priority;
   tid = t->tid = allocate_tid ();
+  old_level = intr_disable ();
+  t->cpu = cpu_current ()->id;
+  intr_set_level (old_level);
+  tid_table_insert (t);
 
   /* Stack frame for kernel_thread(). */
   kf = alloc_frame (t, sizeof *kf);
@@ -241,6 +425,7 @@ thread_block (void)
   ASSERT (intr_get_level () == INTR_OFF);
 
   thread_current ()->status = THREAD_BLOCKED;
+  thread_trace (TRACE_BLOCK, thread_current (), 0);
   schedule ();
 }
 
@@ -260,8 +445,9 @@ thread_unblock (struct thread *t)
 
   old_level = intr_disable ();
   ASSERT (t->status == THREAD_BLOCKED);
-  list_insert_ordered(&ready_list, &t->elem, thread_priority_compare1, NULL);
+  ready_queue_push (&cpus[t->cpu], t);
   t->status = THREAD_READY;
+  thread_trace (TRACE_UNBLOCK, t, t->priority);
   intr_set_level (old_level);
 }
 
@@ -309,9 +495,12 @@ thread_exit (void)
   process_exit ();
 #endif
 
+  tid_table_remove (thread_current ());
+
   /* Just set our status to dying and schedule another process.
      We will be destroyed during the call to schedule_tail(). */
   intr_disable ();
+  list_remove (&thread_current ()->all_elem);
   thread_current ()->status = THREAD_DYING;
   schedule ();
   NOT_REACHED ();
@@ -328,11 +517,9 @@ thread_yield (void)
   ASSERT (!intr_context ());
 
   old_level = intr_disable ();
-  if (curr != idle_thread)
-  {
-    list_insert_ordered(&ready_list, &curr->elem, thread_priority_compare1, NULL);
-  } 
-    
+  if (!is_idle_thread (curr))
+    ready_queue_push (&cpus[curr->cpu], curr);
+
   curr->status = THREAD_READY;
   schedule ();
   intr_set_level (old_level);
@@ -343,13 +530,76 @@ void
 thread_set_priority (int new_priority) 
 {
   struct thread *curr = thread_current();
-  int old_priority = curr->priority;
+
+  /* The 4.4BSD scheduler computes priorities itself. */
+  if (thread_mlfqs)
+    return;
+
+  enum intr_level old_level;
+  int max_ready;
+
+  old_level = intr_disable ();
   curr->base_priority = new_priority;
-  if(curr->donation == 0)
-  {
-    curr->priority = new_priority;
-    thread_preemption(old_priority);
-  }
+  thread_update_priority (curr, thread_effective_priority (curr));
+  max_ready = ready_queue_max (&cpu_current ()->rq);
+  intr_set_level (old_level);
+
+  thread_preemption (max_ready);
+}
+
+/* Returns the priority T should run at: the greater of its base
+   priority and the best priority donated through the locks it
+   holds.  Interrupts must be off. */
+int
+thread_effective_priority (struct thread *t)
+{
+  struct heap_elem *top = heap_top (&t->held_locks);
+  int priority = t->base_priority;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (top != NULL)
+    {
+      int donated = heap_entry (top, struct lock, holder_elem)->priority;
+      if (donated > priority)
+        priority = donated;
+    }
+  return priority;
+}
+
+/* Changes T's effective priority to PRIORITY.  If T is sitting
+   in the ready queue, it is moved to the queue for its new
+   priority, behind any threads already waiting there.  If T is
+   waiting on a semaphore or condition variable, its place in
+   that wait queue is updated too. */
+void
+thread_update_priority (struct thread *t, int priority)
+{
+  enum intr_level old_level;
+  int old_priority;
+
+  ASSERT (is_thread (t));
+  ASSERT (PRI_MIN <= priority && priority <= PRI_MAX);
+
+  old_level = intr_disable ();
+  old_priority = t->priority;
+  if (t->status == THREAD_READY && t->priority != priority)
+    {
+      ready_queue_remove (&cpus[t->cpu], t);
+      t->priority = priority;
+      ready_queue_push (&cpus[t->cpu], t);
+    }
+  else
+    t->priority = priority;
+
+  if (t->waiting_on != NULL && priority != old_priority)
+    {
+      if (priority > old_priority)
+        heap_increase (t->waiting_on, t->waiting_elem);
+      else
+        heap_update (t->waiting_on, t->waiting_elem);
+    }
+  intr_set_level (old_level);
 }
 
 void
@@ -358,6 +608,14 @@ thread_preemption (int priority)
   if(thread_current()->priority < priority) thread_yield();
 }
 
+/* Returns true if some thread other than the running one is
+   ready to run on this CPU. */
+bool
+thread_others_ready (void)
+{
+  return cpu_current ()->rq.cnt > 0;
+}
+
 /* Returns the current thread's priority. */
 int
 thread_get_priority (void) 
@@ -365,46 +623,194 @@ thread_get_priority (void)
   return thread_current ()->priority;
 }
 
-/* Sets the current thread's nice value to NICE. */
+/* Sets the current thread's nice value to NICE, recalculates
+   its priority, and yields if it no longer has the highest
+   priority. */
 void
-thread_set_nice (int nice UNUSED) 
+thread_set_nice (int nice) 
 {
-  /* Not yet implemented. */
+  struct thread *curr = thread_current ();
+  enum intr_level old_level;
+  int max_ready;
+
+  if (nice < NICE_MIN)
+    nice = NICE_MIN;
+  else if (nice > NICE_MAX)
+    nice = NICE_MAX;
+
+  old_level = intr_disable ();
+  curr->nice = nice;
+  if (thread_mlfqs)
+    mlfqs_update_priority (curr);
+  max_ready = ready_queue_max (&cpu_current ()->rq);
+  intr_set_level (old_level);
+
+  thread_preemption (max_ready);
 }
 
 /* Returns the current thread's nice value. */
 int
 thread_get_nice (void) 
 {
-  /* Not yet implemented. */
-  return 0;
+  return thread_current ()->nice;
 }
 
 /* Returns 100 times the system load average. */
 int
 thread_get_load_avg (void) 
 {
-  /* Not yet implemented. */
-  return 0;
+  enum intr_level old_level = intr_disable ();
+  int load_avg_100 = fp_to_int_round (fp_mul_int (load_avg, 100));
+  intr_set_level (old_level);
+
+  return load_avg_100;
 }
 
 /* Returns 100 times the current thread's recent_cpu value. */
 int
 thread_get_recent_cpu (void) 
 {
-  /* Not yet implemented. */
-  return 0;
+  enum intr_level old_level = intr_disable ();
+  int recent_cpu_100 = fp_to_int_round (fp_mul_int (thread_current ()->recent_cpu, 100));
+  intr_set_level (old_level);
+
+  return recent_cpu_100;
 }
 
-static bool
-thread_priority_compare1(const struct list_elem* a, const struct list_elem* b, void* aux UNUSED)
+/* Recalculates the system load average as
+     load_avg = (59/60) * load_avg + (1/60) * ready_threads,
+   where ready_threads counts the running threads (other than
+   idle threads) and every thread in the ready queues. */
+static void
+mlfqs_update_load_avg (void)
+{
+  int ready_threads = 0;
+  int i;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (i = 0; i < cpu_cnt; i++)
+    ready_threads += cpus[i].rq.cnt;
+  if (!is_idle_thread (running_thread ()))
+    ready_threads++;
+  load_avg = fp_add (fp_div_int (fp_mul_int (load_avg, 59), 60),
+                     fp_div_int (fp_from_int (ready_threads), 60));
+}
+
+/* Decays T's recent_cpu according to the load average:
+     recent_cpu = (2*load_avg)/(2*load_avg + 1) * recent_cpu + nice. */
+static void
+mlfqs_update_recent_cpu (struct thread *t)
+{
+  fixed_t twice_load = fp_mul_int (load_avg, 2);
+  fixed_t coeff = fp_div (twice_load, fp_add_int (twice_load, 1));
+
+  t->recent_cpu = fp_add_int (fp_mul (coeff, t->recent_cpu), t->nice);
+}
+
+/* Recalculates T's priority as
+     priority = PRI_MAX - (recent_cpu / 4) - (nice * 2),
+   with recent_cpu / 4 truncated toward zero, as 4.4BSD does, and
+   clamped to PRI_MIN...PRI_MAX, moving T to its new ready queue
+   if necessary. */
+static void
+mlfqs_update_priority (struct thread *t)
+{
+  int priority = PRI_MAX - fp_to_int_trunc (fp_div_int (t->recent_cpu, 4))
+                 - t->nice * 2;
+
+  if (priority < PRI_MIN)
+    priority = PRI_MIN;
+  else if (priority > PRI_MAX)
+    priority = PRI_MAX;
+  t->base_priority = priority;
+  thread_update_priority (t, priority);
+}
+
+/* Initializes RQ as an empty ready queue. */
+static void
+ready_queue_init (struct ready_queue *rq)
+{
+  int pri;
+
+  for (pri = PRI_MIN; pri <= PRI_MAX; pri++)
+    list_init (&rq->lists[pri]);
+  rq->nonempty = 0;
+  rq->cnt = 0;
+}
+
+/* Appends T to the back of C's ready list for T's priority. */
+static void
+ready_queue_push (struct cpu *c, struct thread *t)
+{
+  struct ready_queue *rq = &c->rq;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  list_push_back (&rq->lists[t->priority], &t->elem);
+  rq->nonempty |= (uint64_t) 1 << t->priority;
+  rq->cnt++;
+}
+
+/* Removes T, which must be in C's ready queue at its current
+   priority. */
+static void
+ready_queue_remove (struct cpu *c, struct thread *t)
+{
+  struct ready_queue *rq = &c->rq;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  list_remove (&t->elem);
+  if (list_empty (&rq->lists[t->priority]))
+    rq->nonempty &= ~((uint64_t) 1 << t->priority);
+  rq->cnt--;
+}
+
+/* Returns the highest priority that has a thread in RQ, or -1 if
+   RQ is empty. */
+static int
+ready_queue_max (const struct ready_queue *rq)
 {
-  const struct thread* a_thread = list_entry(a, struct thread, elem);
-  const struct thread* b_thread = list_entry(b, struct thread, elem);
+  uint32_t hi = rq->nonempty >> 32;
+  uint32_t lo = rq->nonempty;
 
-  if(a_thread->priority > b_thread->priority) return true;
-  else if(a_thread->priority == b_thread->priority) return a_thread->wake_ticks< b_thread->wake_ticks;
-  else return false;
+  if (hi != 0)
+    return 63 - __builtin_clz (hi);
+  else if (lo != 0)
+    return 31 - __builtin_clz (lo);
+  else
+    return -1;
+}
+
+/* Removes and returns the thread that has waited longest at the
+   highest nonempty priority level in C's ready queue, or a null
+   pointer if it is empty. */
+static struct thread *
+ready_queue_pop (struct cpu *c)
+{
+  struct ready_queue *rq = &c->rq;
+  struct thread *t = NULL;
+  int pri;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  pri = ready_queue_max (rq);
+  if (pri >= 0)
+    {
+      t = list_entry (list_pop_front (&rq->lists[pri]), struct thread, elem);
+      if (list_empty (&rq->lists[pri]))
+        rq->nonempty &= ~((uint64_t) 1 << pri);
+      rq->cnt--;
+    }
+  return t;
+}
+
+/* Returns true if T is some CPU's idle thread. */
+static bool
+is_idle_thread (const struct thread *t)
+{
+  return cpus[t->cpu].idle_thread == t;
 }
 
 
@@ -420,7 +826,7 @@ static void
 idle (void *idle_started_ UNUSED) 
 {
   struct semaphore *idle_started = idle_started_;
-  idle_thread = thread_current ();
+  cpu_current ()->idle_thread = thread_current ();
   sema_up (idle_started);
 
   for (;;) 
@@ -429,17 +835,10 @@ idle (void *idle_started_ UNUSED)
       intr_disable ();
       thread_block ();
 
-      /* Re-enable interrupts and wait for the next one.
-         The `sti' instruction disables interrupts until the
-         completion of the next instruction, so these two
-         instructions are executed atomically.  This atomicity is
-         important; otherwise, an interrupt could be handled
-         between re-enabling interrupts and waiting for the next
-         one to occur, wasting as much as one clock tick worth of
-         time.
-         See [IA32-v2a] "HLT", [IA32-v2b] "STI", and [IA32-v3a]
-         7.11.1 "HLT Instruction". */
-      asm volatile ("sti; hlt" : : : "memory");
+      /* Re-enable interrupts and wait for the next one,
+         skipping quiet timer ticks in tickless mode.  See
+         timer_idle(). */
+      timer_idle ();
     }
 }
 
@@ -480,6 +879,9 @@ is_thread (struct thread *t)
 static void
 init_thread (struct thread *t, const char *name, int priority)
 {
+  struct thread *parent = running_thread ();
+  enum intr_level old_level;
+
   ASSERT (t != NULL);
   ASSERT (PRI_MIN <= priority && priority <= PRI_MAX);
   ASSERT (name != NULL);
@@ -492,18 +894,36 @@ init_thread (struct thread *t, const char *name, int priority)
   /*project1*/
   t->priority = priority;
   t->base_priority = priority;
-  t->donation = 0;
-  list_init(&t->key);
-  t->lock_held = NULL;
+  heap_init (&t->held_locks, lock_priority_less, NULL);
+  t->waiting_lock = NULL;
   t->magic = THREAD_MAGIC;
 
+  /* Under the 4.4BSD scheduler, a new thread inherits its
+     parent's niceness and recent_cpu, and the PRIORITY argument
+     is ignored. */
+  if (parent != t && is_thread (parent))
+    {
+      t->nice = parent->nice;
+      t->recent_cpu = parent->recent_cpu;
+    }
+  else
+    {
+      t->nice = NICE_DEFAULT;
+      t->recent_cpu = 0;
+    }
+  if (thread_mlfqs)
+    mlfqs_update_priority (t);
+
   /*project2*/
   list_init(&t->child_list);
   list_init(&t->file_list);
   t->fd = 2; 
   t->parent_tid = -1;
   t->wait_tid = -1;
+
+  old_level = intr_disable ();
   list_push_back(&all_thread,&t->all_elem);
+  intr_set_level (old_level);
 
 }
 
@@ -528,10 +948,10 @@ alloc_frame (struct thread *t, size_t size)
 static struct thread *
 next_thread_to_run (void) 
 {
-  if (list_empty (&ready_list))
-    return idle_thread;
-  else
-    return list_entry (list_pop_front (&ready_list), struct thread, elem);
+  struct cpu *c = cpu_current ();
+  struct thread *t = ready_queue_pop (c);
+
+  return t != NULL ? t : c->idle_thread;
 }
 
 /* Completes a thread switch by activating the new thread's page
@@ -588,15 +1008,27 @@ static void
 schedule (void) 
 {
   struct thread *curr = running_thread ();
-  struct thread *next = next_thread_to_run ();
+  struct thread *next;
   struct thread *prev = NULL;
 
   ASSERT (intr_get_level () == INTR_OFF);
   ASSERT (curr->status != THREAD_RUNNING);
+
+  /* Under the MLFQS, CURR's recent_cpu may have grown since its
+     priority was last computed.  Nothing else will recompute it
+     before the next second, so do it now, before the next thread
+     is chosen. */
+  if (thread_mlfqs && curr->status != THREAD_DYING && !is_idle_thread (curr))
+    mlfqs_update_priority (curr);
+
+  next = next_thread_to_run ();
   ASSERT (is_thread (next));
 
   if (curr != next)
-    prev = switch_threads (curr, next);
+    {
+      thread_trace (TRACE_SWITCH, next, curr->tid);
+      prev = switch_threads (curr, next);
+    }
   schedule_tail (prev); 
 }
 
@@ -614,6 +1046,41 @@ allocate_tid (void)
   return tid;
 }
 
+/* Adds T to the tid table. */
+static void
+tid_table_insert (struct thread *t)
+{
+  lock_acquire (&tid_table_lock);
+  hash_insert (&tid_table, &t->tid_elem);
+  lock_release (&tid_table_lock);
+}
+
+/* Removes T from the tid table. */
+static void
+tid_table_remove (struct thread *t)
+{
+  lock_acquire (&tid_table_lock);
+  hash_delete (&tid_table, &t->tid_elem);
+  lock_release (&tid_table_lock);
+}
+
+/* Returns a hash value for the thread containing E. */
+static unsigned
+tid_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  return hash_int (hash_entry (e, struct thread, tid_elem)->tid);
+}
+
+/* Returns true if the thread containing A has a lower tid than
+   the one containing B. */
+static bool
+tid_less (const struct hash_elem *a, const struct hash_elem *b,
+          void *aux UNUSED)
+{
+  return (hash_entry (a, struct thread, tid_elem)->tid
+          < hash_entry (b, struct thread, tid_elem)->tid);
+}
+
 /* Offset of `stack' member within `struct thread'.
    Used by switch.S, which can't figure it out on its own. */
 uint32_t thread_stack_ofs = offsetof (struct thread, stack);
\ No newline at end of file
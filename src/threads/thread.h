@@ -3,8 +3,11 @@
 #define THREADS_THREAD_H
 
 #include <debug.h>
+#include <hash.h>
+#include <heap.h>
 #include <list.h>
 #include <stdint.h>
+#include "threads/fixed-point.h"
 
 /* States in a thread's life cycle. */
 enum thread_status
@@ -26,6 +29,11 @@ typedef int tid_t;
 #define PRI_DEFAULT 31                  /* Default priority. */
 #define PRI_MAX 63                      /* Highest priority. */
 
+/* Thread niceness, for the multi-level feedback queue scheduler. */
+#define NICE_MIN -20                    /* Nicest. */
+#define NICE_DEFAULT 0                  /* Default niceness. */
+#define NICE_MAX 20                     /* Least nice. */
+
 /* A kernel thread or user process.
    Each thread structure is stored in its own 4 kB page.  The
    thread structure itself sits at the very bottom of the page
@@ -71,11 +79,12 @@ typedef int tid_t;
    set to THREAD_MAGIC.  Stack overflow will normally change this
    value, triggering the assertion. */
 /* The `elem' member has a dual purpose.  It can be an element in
-   the run queue (thread.c), or it can be an element in a
-   semaphore wait list (synch.c).  It can be used these two ways
+   the run queue (thread.c), or it can be an element in the
+   timer's sleep wheel (timer.c).  It can be used these two ways
    only because they are mutually exclusive: only a thread in the
    ready state is on the run queue, whereas only a thread in the
-   blocked state is on a semaphore wait list. */
+   blocked state is in the sleep wheel.  Semaphores keep their
+   waiters in a priority heap through `wait_elem' instead. */
 struct thread
   {
     /* Owned by thread.c. */
@@ -83,6 +92,7 @@ struct thread
     enum thread_status status;          /* Thread state. */
     char name[16];                      /* Name (for debugging purposes). */
     uint8_t *stack;                     /* Saved stack pointer. */
+    int cpu;                            /* CPU whose run queue we use. */
 
 
     int priority;                       /* Priority. */
@@ -94,9 +104,15 @@ struct thread
     /*[project1]*/
     int64_t wake_ticks;                 /* for wake up thread [project1-alarm clock]*/
 
-    int donation;                       /* number of the donation on thread*/
-    struct lock *lock_held;             /* Lock held on the thread */ 
-    struct list key;                    /* List of lock which the thread is holding */
+    struct heap_elem wait_elem;         /* Element in a semaphore's waiters. */
+    struct heap *waiting_on;            /* Wait queue ordered by our priority. */
+    struct heap_elem *waiting_elem;     /* Our element in `waiting_on'. */
+
+    struct lock *waiting_lock;          /* Lock we are waiting to acquire. */
+    struct heap held_locks;             /* Locks we hold, by donated priority. */
+
+    int nice;                           /* Niceness [project1-mlfqs] */
+    fixed_t recent_cpu;                 /* Recent CPU time received [project1-mlfqs] */
 
     /*[project2]*/
     int fd;                             /*file discriptor [project2-syscall] */
@@ -105,6 +121,7 @@ struct thread
     int wait_tid;
     struct list child_list;
     struct list_elem all_elem;
+    struct hash_elem tid_elem;          /* Element in thread.c's tid table. */
 
 #ifdef USERPROG
     /* Owned by userprog/process.c. */
@@ -131,11 +148,28 @@ struct child
    Controlled by kernel command-line option "-o mlfqs". */
 extern bool thread_mlfqs;
 
+/* If true, record scheduler events in a trace ring and dump it
+   over the serial port at shutdown or panic.
+   Controlled by kernel command-line option "-trace". */
+extern bool thread_trace_enabled;
+
+/* Scheduler events recorded by thread_trace(). */
+enum trace_event
+  {
+    TRACE_SWITCH,               /* Thread switched in; ARG is previous tid. */
+    TRACE_BLOCK,                /* Thread blocked. */
+    TRACE_UNBLOCK,              /* Thread made ready; ARG is its priority. */
+    TRACE_DONATE,               /* Thread got a donation; ARG is priority. */
+    TRACE_WAKEUP                /* Timer woke a sleeping thread. */
+  };
+
 void thread_init (void);
 void thread_start (void);
 
 void thread_tick (void);
 void thread_print_stats (void);
+void thread_trace (enum trace_event, const struct thread *, int arg);
+void thread_trace_dump (void);
 
 typedef void thread_func (void *aux);
 tid_t thread_create (const char *name, int priority, thread_func *, void *);
@@ -149,6 +183,7 @@ const char *thread_name (void);
 
 void thread_exit (void) NO_RETURN;
 void thread_yield (void);
+bool thread_others_ready (void);
 
 int thread_get_priority (void);
 void thread_set_priority (int);
@@ -159,5 +194,7 @@ int thread_get_recent_cpu (void);
 int thread_get_load_avg (void);
 static bool thread_priority_compare(const struct list_elem* a, const struct list_elem* b, void* aux UNUSED);
 void thread_preemption (int priority);
+void thread_update_priority (struct thread *, int priority);
+int thread_effective_priority (struct thread *);
 struct thread * get_thread(int tid);
 #endif /* threads/thread.h */
@@ -0,0 +1,163 @@
+#include "threads/vmalloc.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <round.h>
+#include <stdio.h>
+#include "threads/init.h"
+#include "threads/palloc.h"
+#include "threads/pte.h"
+#include "threads/synch.h"
+
+/* Virtually contiguous kernel allocations.
+
+   The page allocator can only satisfy a multi-page request with
+   physically contiguous pages, which become scarce as the kernel
+   pool fragments.  vmalloc() instead takes any free pages from
+   the kernel pool, one at a time, and maps them at consecutive
+   addresses in a range of kernel virtual memory set aside for
+   the purpose, VMALLOC_START through VMALLOC_START +
+   VMALLOC_PAGES * PGSIZE.
+
+   The page tables for the whole range are created by
+   vmalloc_init() at boot, before any process page directory
+   exists.  Every page directory is a copy of base_page_dir, so
+   they all share those page tables, and a mapping added later
+   is immediately visible in every address space.
+
+   Each allocation is followed by an unmapped guard page, so that
+   running off its end faults instead of corrupting a neighbor.
+   vmalloc() memory is not physically contiguous, so vtop() must
+   not be used on it. */
+
+/* Pages of the range that are reserved, including guard pages. */
+static struct bitmap *used_map;
+static uint8_t used_map_buf[VMALLOC_PAGES / 8 + 16];
+
+/* For the first page of each allocation, its number of pages. */
+static uint16_t page_cnts[VMALLOC_PAGES];
+
+/* Protects used_map, page_cnts, and the range's page tables. */
+static struct lock vmalloc_lock;
+
+static uint32_t *lookup_pte (const void *vaddr);
+static void unmap_pages (uint8_t *vaddr, size_t page_cnt);
+
+/* Creates the page tables for the vmalloc() range in
+   base_page_dir.  Must be called after paging_init() and before
+   the first page directory is created. */
+void
+vmalloc_init (void) 
+{
+  uint8_t *vaddr;
+
+  ASSERT (ptov (ram_pages * PGSIZE) <= (void *) VMALLOC_START);
+  ASSERT (sizeof used_map_buf >= bitmap_buf_size (VMALLOC_PAGES));
+
+  for (vaddr = VMALLOC_START; vaddr < VMALLOC_START + VMALLOC_PAGES * PGSIZE;
+       vaddr += PTSPAN)
+    {
+      uint32_t *pt = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+      ASSERT (base_page_dir[pd_no (vaddr)] == 0);
+      base_page_dir[pd_no (vaddr)] = pde_create (pt);
+    }
+
+  used_map = bitmap_create_in_buf (VMALLOC_PAGES, used_map_buf,
+                                   sizeof used_map_buf);
+  lock_init_named (&vmalloc_lock, "vmalloc");
+}
+
+/* Obtains PAGE_CNT pages, not necessarily physically contiguous,
+   from the kernel pool, maps them at consecutive kernel virtual
+   addresses, and returns the first address.  Returns a null
+   pointer if there is not enough memory or address space. */
+void *
+vmalloc (size_t page_cnt) 
+{
+  uint8_t *vaddr;
+  size_t page_idx, i;
+
+  if (page_cnt == 0 || page_cnt >= VMALLOC_PAGES)
+    return NULL;
+
+  lock_acquire (&vmalloc_lock);
+  page_idx = bitmap_scan_and_flip_next (used_map, page_cnt + 1, false);
+  if (page_idx == BITMAP_ERROR)
+    {
+      lock_release (&vmalloc_lock);
+      return NULL;
+    }
+  page_cnts[page_idx] = page_cnt;
+  vaddr = VMALLOC_START + page_idx * PGSIZE;
+
+  for (i = 0; i < page_cnt; i++)
+    {
+      void *kpage = palloc_get_page (0);
+      if (kpage == NULL)
+        {
+          unmap_pages (vaddr, i);
+          bitmap_set_multiple (used_map, page_idx, page_cnt + 1, false);
+          lock_release (&vmalloc_lock);
+          return NULL;
+        }
+      *lookup_pte (vaddr + i * PGSIZE) = pte_create_kernel (kpage, true);
+    }
+  lock_release (&vmalloc_lock);
+
+  return vaddr;
+}
+
+/* Frees VADDR, which must have been returned by vmalloc(), and
+   the pages mapped there. */
+void
+vfree (void *vaddr_) 
+{
+  uint8_t *vaddr = vaddr_;
+  size_t page_idx, page_cnt;
+
+  if (vaddr == NULL)
+    return;
+  ASSERT (is_vmalloc_vaddr (vaddr));
+  ASSERT (pg_ofs (vaddr) == 0);
+
+  page_idx = (vaddr - VMALLOC_START) / PGSIZE;
+
+  lock_acquire (&vmalloc_lock);
+  page_cnt = page_cnts[page_idx];
+  ASSERT (page_cnt > 0);
+  ASSERT (bitmap_all (used_map, page_idx, page_cnt + 1));
+  unmap_pages (vaddr, page_cnt);
+  page_cnts[page_idx] = 0;
+  bitmap_set_multiple (used_map, page_idx, page_cnt + 1, false);
+  lock_release (&vmalloc_lock);
+}
+
+/* Returns the address of the page table entry for VADDR, which
+   must be in the vmalloc() range. */
+static uint32_t *
+lookup_pte (const void *vaddr) 
+{
+  ASSERT (is_vmalloc_vaddr (vaddr));
+  return pde_get_pt (base_page_dir[pd_no (vaddr)]) + pt_no (vaddr);
+}
+
+/* Unmaps the PAGE_CNT pages starting at VADDR and gives the
+   pages that were mapped there back to the page allocator. */
+static void
+unmap_pages (uint8_t *vaddr, size_t page_cnt) 
+{
+  size_t i;
+
+  for (i = 0; i < page_cnt; i++)
+    {
+      uint8_t *va = vaddr + i * PGSIZE;
+      uint32_t *pte = lookup_pte (va);
+
+      ASSERT (*pte & PTE_P);
+      palloc_free_page (pte_get_page (*pte));
+      *pte = 0;
+
+      /* Flush the stale translation from the TLB.  See [IA32-v3a]
+         3.12 "Translation Lookaside Buffers (TLBs)". */
+      asm volatile ("invlpg (%0)" : : "r" (va) : "memory");
+    }
+}
@@ -0,0 +1,26 @@
+#ifndef THREADS_VMALLOC_H
+#define THREADS_VMALLOC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "threads/vaddr.h"
+
+/* Kernel virtual address range reserved for vmalloc(), above
+   the kernel's direct mapping of physical memory. */
+#define VMALLOC_START ((uint8_t *) PHYS_BASE + 0x30000000)
+#define VMALLOC_PAGES 4096
+
+void vmalloc_init (void);
+void *vmalloc (size_t page_cnt);
+void vfree (void *);
+
+/* Returns true if VADDR lies in the vmalloc() range. */
+static inline bool
+is_vmalloc_vaddr (const void *vaddr) 
+{
+  return (const uint8_t *) vaddr >= VMALLOC_START
+          && (const uint8_t *) vaddr < VMALLOC_START + VMALLOC_PAGES * PGSIZE;
+}
+
+#endif /* threads/vmalloc.h */
@@ -58,7 +58,9 @@ process_execute (const char *file_name)
   struct thread *curr = thread_current();
   child_thread->parent_tid = curr -> tid;
 
-  struct child *child_t;
+  struct child *child_t = kmem_cache_alloc(&child_cache);
+  if (child_t == NULL)
+    return tid;
   child_t -> pid = tid;
   child_t -> is_exited = -1;
 
@@ -172,13 +174,14 @@ process_exit (void)
     lock_acquire(&lock_filesys);
     file_close(file_des -> file);
     lock_release(&lock_filesys);
+    kmem_cache_free(&file_descriptor_cache, file_des);
   }
 
   /*자신이 가지고 있는 child 구조체를 모두 free시킴*/
   while(!list_empty(&curr->child_list))
   {
     struct child *child_t = list_entry(list_pop_back(&curr->child_list),struct child,elem);
-    free(child_t);
+    kmem_cache_free(&child_cache, child_t);
   }
 
   /*parent에 저장된 child 구조체의 is_exited 값을 변경*/
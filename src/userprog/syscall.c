@@ -34,6 +34,8 @@ void close(int fd);
 struct file *get_file(int fd);
 
 struct lock lock_filesys;
+struct kmem_cache child_cache;
+struct kmem_cache file_descriptor_cache;
 
 /*
 file descriptor로 syscall_init에서 초기화하고
@@ -43,7 +45,10 @@ void
 syscall_init (void) 
 {
 	intr_register_int (0x30, 3, INTR_ON, syscall_handler, "syscall");
-	lock_init(&lock_filesys);
+	lock_init_named(&lock_filesys, "filesys");
+	kmem_cache_init(&child_cache, "child", sizeof (struct child), NULL);
+	kmem_cache_init(&file_descriptor_cache, "file_descriptor",
+	                sizeof (struct file_descriptor), NULL);
 }
 
 static void
@@ -231,11 +236,18 @@ open(const char *file){
 		struct thread *curr = thread_current();
 		struct file_descriptor *file_descriptor;
 		
-		file_descriptor->file = f;
-		file_descriptor->fd = curr->fd;
-		list_push_back(&(curr->file_list), &(file_descriptor->elem));
-		result = curr->fd;
-		curr->fd++;
+		file_descriptor = kmem_cache_alloc(&file_descriptor_cache);
+		if(file_descriptor == NULL){
+			file_close(f);
+			result = -1;
+		}
+		else{
+			file_descriptor->file = f;
+			file_descriptor->fd = curr->fd;
+			list_push_back(&(curr->file_list), &(file_descriptor->elem));
+			result = curr->fd;
+			curr->fd++;
+		}
 	}
 	lock_release(&lock_filesys);
 
@@ -376,6 +388,7 @@ close(int fd){
 			lock_acquire(&lock_filesys);
 			file_close(file_descriptor->file);
 			lock_release(&lock_filesys);
+			kmem_cache_free(&file_descriptor_cache, file_descriptor);
 			break;
 		}
 	}
@@ -2,9 +2,14 @@
 #define USERPROG_SYSCALL_H
 
 #include "lib/kernel/list.h"
+#include "threads/slab.h"
 
 void syscall_init (void);
 
+/* Caches of struct child and struct file_descriptor. */
+extern struct kmem_cache child_cache;
+extern struct kmem_cache file_descriptor_cache;
+
 struct file_descriptor{
 	struct file *file;
 	int fd;